@@ -0,0 +1,180 @@
+#pragma once
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bench {
+
+struct options {
+  size_t      warmup      = 2;
+  size_t      repetitions = 10;
+  std::string filter;    // substring of the benchmark names to run
+};
+
+// seconds per run over the repetitions
+struct summary {
+  double min;
+  double median;
+  double mean;
+  double stddev;
+};
+
+// written by keep, volatile so no store to it is dropped
+inline volatile const void* sink = nullptr;
+
+// keeps the compiler from dropping the computation of value
+template<typename T>
+void keep(const T& value) {
+  sink = &value;
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+inline bool selected(const options& opts, std::string_view name) {
+  return opts.filter.empty() ||
+         name.find(opts.filter) != std::string_view::npos;
+}
+
+template<typename Fn>
+summary run(const options& opts, Fn fn) {
+  for (size_t rep = 0; rep < opts.warmup; ++rep) {
+    fn();
+  }
+
+  std::vector<double> seconds;
+  seconds.reserve(opts.repetitions);
+  for (size_t rep = 0; rep < std::max<size_t>(opts.repetitions, 1); ++rep) {
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    const auto stop = std::chrono::steady_clock::now();
+    seconds.push_back(std::chrono::duration<double>(stop - start).count());
+  }
+
+  std::sort(seconds.begin(), seconds.end());
+
+  const auto   count = static_cast<double>(seconds.size());
+  const double mean =
+  std::accumulate(seconds.begin(), seconds.end(), 0.0) / count;
+  double variance = 0.0;
+  for (const double second : seconds) {
+    variance += (second - mean) * (second - mean);
+  }
+
+  const size_t middle = seconds.size() / 2;
+  return {.min    = seconds.front(),
+          .median = seconds.size() % 2 == 1
+                    ? seconds[middle]
+                    : (seconds[middle - 1] + seconds[middle]) / 2.0,
+          .mean   = mean,
+          .stddev = std::sqrt(variance / count)};
+}
+
+// ns/byte and MB/s of the median, min and mean +- stddev in ns/byte
+inline void report(std::string_view name, size_t bytes, const summary& stats) {
+  const auto ns_per_byte = [&](double seconds) {
+    return seconds * 1e9 / static_cast<double>(bytes);
+  };
+
+  fmt::println("{:<44} {:>9.3f} ns/B {:>9.2f} MB/s   min {:.3f} mean {:.3f} "
+               "+- {:.3f}",
+               name,
+               ns_per_byte(stats.median),
+               static_cast<double>(bytes) / stats.median / 1e6,
+               ns_per_byte(stats.min),
+               ns_per_byte(stats.mean),
+               ns_per_byte(stats.stddev));
+}
+
+// run and report fn, which processes bytes per call, if name is selected
+template<typename Fn>
+void measure(const options& opts, std::string_view name, size_t bytes, Fn fn) {
+  if (!selected(opts, name)) {
+    return;
+  }
+  report(name, bytes, run(opts, fn));
+}
+
+enum class data_kind {
+  random,    // uniform bytes
+  text,      // skewed small alphabet
+  zeros,     // single repeated byte
+  ramp,      // little endian 32 bit counter
+};
+
+inline std::string_view name_of(data_kind kind) {
+  switch (kind) {
+    case data_kind::random:
+      return "random";
+    case data_kind::text:
+      return "text";
+    case data_kind::zeros:
+      return "zeros";
+    case data_kind::ramp:
+      return "ramp";
+  }
+  return "";
+}
+
+inline std::vector<uint8_t> create_data(data_kind kind, size_t size) {
+  std::vector<uint8_t> data(size);
+  std::mt19937         gen {42};
+
+  switch (kind) {
+    case data_kind::random: {
+      std::uniform_int_distribution dist {0, 255};
+      for (auto& byte : data) {
+        byte = static_cast<uint8_t>(dist(gen));
+      }
+      break;
+    }
+    case data_kind::text: {
+      std::geometric_distribution dist {0.15};
+      for (auto& byte : data) {
+        byte = static_cast<uint8_t>('a' + dist(gen) % 26);
+      }
+      break;
+    }
+    case data_kind::zeros:
+      break;
+    case data_kind::ramp:
+      for (size_t idx = 0; idx < size; ++idx) {
+        data[idx] = static_cast<uint8_t>((idx / 4) >> (8 * (idx % 4)));
+      }
+      break;
+  }
+
+  return data;
+}
+
+// corpus round trips reported as JSON and compared against a baseline
+struct regression_options {
+  std::string report;      // JSON report to write, empty for none
+  std::string baseline;    // JSON report to compare against, empty for none
+  size_t      dataset_size    = 64 * 1024;
+  uint32_t    seed            = 1;
+  double      ratio_tolerance = 0.005;    // relative ratio loss allowed
+  double      speed_tolerance = 0.25;     // relative MB/s loss allowed
+};
+
+// per area benchmarks, each in its own translation unit
+void run_kernels(const options& opts);
+void run_entropy(const options& opts);
+void run_end_to_end(const options& opts);
+
+// @return 0, or 1 if calls with reused contexts still allocate
+int run_context(const options& opts);
+
+// @return 0, or 1 on a failed round trip or a regression against baseline
+int run_regression(const options& opts, const regression_options& regression);
+
+}    // namespace bench
@@ -0,0 +1,171 @@
+#include "COMPRESS.hpp"
+#include "bench.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iterator>
+#include <new>
+#include <random>
+#include <vector>
+
+// ALLOCATION COUNTING v
+
+namespace {
+
+std::atomic<size_t> allocations {0};
+
+}    // namespace
+
+// counts every allocation of the benchmark binary
+void* operator new(size_t size) {
+  ++allocations;
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc {};
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t /*unused*/) noexcept {
+  std::free(ptr);
+}
+
+// ALLOCATION COUNTING ^
+// CONTEXT v
+
+namespace bench {
+
+namespace {
+
+constexpr uint8_t rule         = 220;
+constexpr size_t  section_size = 40;
+
+std::vector<uint8_t> create_message(size_t size, std::mt19937& gen) {
+  // skewed bytes so the huffman tree is not trivial
+  std::geometric_distribution dist {0.05};
+
+  std::vector<uint8_t> message(size);
+  for (auto& byte : message) {
+    byte = static_cast<uint8_t>(dist(gen));
+  }
+  return message;
+}
+
+struct round_trip_stats {
+  double allocations_per_call;
+  double ns_per_call;
+};
+
+// compress + decompress of every message, repeated calls reuse out buffers
+template<typename RoundTrip>
+round_trip_stats measure_round_trips(
+const std::vector<std::vector<uint8_t>>& messages,
+size_t                                   repetitions,
+RoundTrip                                round_trip) {
+  // warmup grows the buffers to the largest message
+  for (const auto& message : messages) {
+    round_trip(message);
+  }
+
+  const size_t before = allocations.load();
+  const auto   start  = std::chrono::steady_clock::now();
+
+  for (size_t rep = 0; rep < repetitions; ++rep) {
+    for (const auto& message : messages) {
+      round_trip(message);
+    }
+  }
+
+  const auto   stop  = std::chrono::steady_clock::now();
+  const size_t after = allocations.load();
+
+  const auto calls = static_cast<double>(repetitions * messages.size());
+  return {
+    .allocations_per_call = static_cast<double>(after - before) / calls,
+    .ns_per_call =
+    std::chrono::duration<double, std::nano>(stop - start).count() / calls};
+}
+
+// @return false if calls with reused contexts still allocate
+bool bench_context(const options& opts) {
+  std::mt19937                      gen {42};
+  std::vector<std::vector<uint8_t>> messages;
+  for (const size_t size : {64, 256, 1024, 4096}) {
+    messages.push_back(create_message(size, gen));
+  }
+
+  std::vector<uint8_t> compressed;
+  std::vector<uint8_t> decompressed;
+  compressed.reserve(8192);
+  decompressed.reserve(8192);
+
+  const auto fresh =
+  measure_round_trips(messages, opts.repetitions, [&](const auto& msg) {
+    compressed.clear();
+    decompressed.clear();
+    compress(msg.begin(),
+             msg.end(),
+             std::back_inserter(compressed),
+             rule,
+             section_size);
+    decompress(compressed.begin(),
+               compressed.end(),
+               std::back_inserter(decompressed),
+               rule,
+               section_size);
+  });
+
+  compression_context   compress_context;
+  decompression_context decompress_context;
+
+  const auto reused =
+  measure_round_trips(messages, opts.repetitions, [&](const auto& msg) {
+    compressed.clear();
+    decompressed.clear();
+    compress(msg.begin(),
+             msg.end(),
+             std::back_inserter(compressed),
+             compress_context,
+             rule,
+             section_size);
+    decompress(compressed.begin(),
+               compressed.end(),
+               std::back_inserter(decompressed),
+               decompress_context,
+               rule,
+               section_size);
+  });
+
+  fmt::println("context: round trips of 64 B to 4 KiB messages");
+  fmt::println("  fresh:  {:8.2f} allocations/call {:12.0f} ns/call",
+               fresh.allocations_per_call,
+               fresh.ns_per_call);
+  fmt::println("  reused: {:8.2f} allocations/call {:12.0f} ns/call",
+               reused.allocations_per_call,
+               reused.ns_per_call);
+
+  if (reused.allocations_per_call != 0.0) {
+    fmt::println("context: reused contexts allocate, FAILED");
+    return false;
+  }
+  return true;
+}
+
+}    // namespace
+
+int run_context(const options& opts) {
+  if (selected(opts, "context") && !bench_context(opts)) {
+    return 1;
+  }
+  return 0;
+}
+
+}    // namespace bench
+
+// CONTEXT ^
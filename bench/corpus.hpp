@@ -0,0 +1,202 @@
+#pragma once
+
+#include <fmt/core.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// synthetic datasets, identical for a seed on every platform and run
+namespace bench::corpus {
+
+struct dataset {
+  std::string          name;
+  std::vector<uint8_t> data;
+};
+
+namespace impl {
+
+// std distributions differ between standard libraries, these do not
+class generator {
+  std::mt19937 engine;
+
+public:
+  explicit generator(uint32_t seed): engine(seed) {
+  }
+
+  uint32_t next() {
+    return static_cast<uint32_t>(engine());
+  }
+
+  // [0, bound)
+  uint32_t below(uint32_t bound) {
+    return static_cast<uint32_t>((uint64_t {next()} * bound) >> 32);
+  }
+
+  // [0, 1)
+  double unit() {
+    return static_cast<double>(next()) / 4294967296.0;
+  }
+
+  // rank in [0, count), falling off like a harmonic series from rank 0
+  uint32_t skewed(uint32_t count) {
+    return below(below(count) + 1);
+  }
+};
+
+inline void append(std::vector<uint8_t>& out, std::string_view text) {
+  out.insert(out.end(), text.begin(), text.end());
+}
+
+template<typename T>
+void append_le(std::vector<uint8_t>& out, T value) {
+  for (size_t byte = 0; byte < sizeof(T); ++byte) {
+    out.push_back(static_cast<uint8_t>(value >> (8 * byte)));
+  }
+}
+
+constexpr std::array<std::string_view, 35> words {
+"the",  "of",   "and",   "to",       "in",        "a",       "is",
+"that", "for",  "it",    "as",       "was",       "with",    "be",
+"by",   "on",   "not",   "he",       "this",      "are",     "or",
+"his",  "from", "at",    "which",    "but",       "have",    "an",
+"cell", "rule", "state", "cellular", "automaton", "section", "entropy"};
+
+inline std::vector<uint8_t> text(generator& gen, size_t size) {
+  std::vector<uint8_t> out;
+  size_t               sentence = 0;
+  while (out.size() < size) {
+    append(out, words[gen.skewed(words.size())]);
+    if (++sentence % 12 == 0) {
+      append(out, gen.below(4) == 0 ? ".\n" : ". ");
+    } else {
+      append(out, gen.below(10) == 0 ? ", " : " ");
+    }
+  }
+  out.resize(size);
+  return out;
+}
+
+inline std::vector<uint8_t> log_lines(generator& gen, size_t size) {
+  constexpr std::array<std::string_view, 4> levels {"INFO",
+                                                    "DEBUG",
+                                                    "WARN",
+                                                    "ERROR"};
+  constexpr std::array<std::string_view, 5> paths {"/api/v1/users",
+                                                   "/api/v1/orders",
+                                                   "/health",
+                                                   "/static/app.js",
+                                                   "/api/v1/search"};
+  constexpr std::array<int, 4> statuses {200, 200, 404, 500};
+
+  std::vector<uint8_t> out;
+  uint32_t             millis = 0;
+  while (out.size() < size) {
+    millis += gen.below(2000);
+    append(out,
+           fmt::format("2024-03-01T{:02}:{:02}:{:02}.{:03}Z {} [worker-{}] "
+                       "GET {} status={} latency_ms={}\n",
+                       millis / 3'600'000 % 24,
+                       millis / 60'000 % 60,
+                       millis / 1000 % 60,
+                       millis % 1000,
+                       levels[gen.skewed(levels.size())],
+                       gen.below(8),
+                       paths[gen.skewed(paths.size())],
+                       statuses[gen.skewed(statuses.size())],
+                       gen.skewed(500)));
+  }
+  out.resize(size);
+  return out;
+}
+
+// zeros with a random 32 bit value every 64 bytes on average
+inline std::vector<uint8_t> sparse(generator& gen, size_t size) {
+  std::vector<uint8_t> out(size);
+  for (size_t idx = 0; idx + 4 <= size; idx += 4) {
+    if (gen.below(16) == 0) {
+      const uint32_t value = gen.next();
+      for (size_t byte = 0; byte < 4; ++byte) {
+        out[idx + byte] = static_cast<uint8_t>(value >> (8 * byte));
+      }
+    }
+  }
+  return out;
+}
+
+// rows of id (u32), timestamp (u32), price (f32 random walk), quantity (u16)
+inline std::vector<uint8_t> table(generator& gen, size_t size) {
+  std::vector<uint8_t> out;
+  uint32_t             timestamp = 1'700'000'000;
+  float                price     = 100.0F;
+  for (uint32_t id = 0; out.size() < size; ++id) {
+    timestamp += gen.below(5);
+    price     += static_cast<float>(gen.unit() - 0.5);
+    uint32_t price_bits = 0;
+    static_assert(sizeof(price_bits) == sizeof(price));
+    std::memcpy(&price_bits, &price, sizeof(price));
+
+    append_le(out, id);
+    append_le(out, timestamp);
+    append_le(out, price_bits);
+    append_le(out, static_cast<uint16_t>(gen.skewed(1000)));
+  }
+  out.resize(size);
+  return out;
+}
+
+inline std::vector<uint8_t> random(generator& gen, size_t size) {
+  std::vector<uint8_t> out(size);
+  for (auto& byte : out) {
+    byte = static_cast<uint8_t>(gen.next());
+  }
+  return out;
+}
+
+// a 1 KiB pattern repeated with one mutated byte per copy
+inline std::vector<uint8_t> repeated(generator& gen, size_t size) {
+  const auto pattern = random(gen, 1024);
+
+  std::vector<uint8_t> out;
+  while (out.size() < size) {
+    const size_t start = out.size();
+    out.insert(out.end(), pattern.begin(), pattern.end());
+    out[start + gen.below(pattern.size())] = static_cast<uint8_t>(gen.next());
+  }
+  out.resize(size);
+  return out;
+}
+
+}    // namespace impl
+
+// every dataset of the corpus, size bytes each
+inline std::vector<dataset> generate(size_t size, uint32_t seed) {
+  using generate_fn = std::vector<uint8_t> (*)(impl::generator&, size_t);
+
+  constexpr std::array<std::pair<std::string_view, generate_fn>, 6> kinds {{
+    {"text", &impl::text},
+    {"log", &impl::log_lines},
+    {"sparse", &impl::sparse},
+    {"table", &impl::table},
+    {"random", &impl::random},
+    {"repeated", &impl::repeated},
+  }};
+
+  std::vector<dataset> result;
+  for (size_t idx = 0; idx < kinds.size(); ++idx) {
+    // independent stream per dataset, adding one keeps the others unchanged
+    impl::generator gen {seed + static_cast<uint32_t>(idx) * 7919U};
+    result.push_back({.name = std::string(kinds[idx].first),
+                      .data = kinds[idx].second(gen, size)});
+  }
+  return result;
+}
+
+}    // namespace bench::corpus
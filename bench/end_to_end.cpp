@@ -0,0 +1,382 @@
+#include "COMPRESS.hpp"
+#include "PARSE.hpp"
+#include "STREAM.hpp"
+#include "TUNE.hpp"
+#include "bench.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bench {
+
+namespace {
+
+constexpr uint8_t rule         = 220;
+constexpr size_t  section_size = 40;
+
+void bench_size(const options& opts, data_kind kind, size_t size) {
+  const auto data   = create_data(kind, size);
+  const auto suffix = fmt::format("{} {} KiB", name_of(kind), size / 1024);
+
+  std::vector<uint8_t> compressed;
+  std::vector<uint8_t> decompressed;
+  compressed.reserve(size * 2);
+  decompressed.reserve(size);
+
+  compression_context   compress_context;
+  decompression_context decompress_context;
+
+  measure(opts, "compress/template " + suffix, size, [&] {
+    compressed.clear();
+    compress<rule, section_size>(data.begin(),
+                                 data.end(),
+                                 std::back_inserter(compressed),
+                                 compress_context);
+    keep(compressed);
+  });
+
+  measure(opts, "compress/runtime " + suffix, size, [&] {
+    compressed.clear();
+    compress(data.begin(),
+             data.end(),
+             std::back_inserter(compressed),
+             compress_context,
+             rule,
+             section_size);
+    keep(compressed);
+  });
+
+  // decompression input, both APIs produce the same stream
+  compressed.clear();
+  compress(data.begin(),
+           data.end(),
+           std::back_inserter(compressed),
+           compress_context,
+           rule,
+           section_size);
+
+  measure(opts, "decompress/template " + suffix, size, [&] {
+    decompressed.clear();
+    decompress<rule, section_size>(compressed.begin(),
+                                   compressed.end(),
+                                   std::back_inserter(decompressed),
+                                   decompress_context);
+    keep(decompressed);
+  });
+
+  measure(opts, "decompress/runtime " + suffix, size, [&] {
+    decompressed.clear();
+    decompress(compressed.begin(),
+               compressed.end(),
+               std::back_inserter(decompressed),
+               decompress_context,
+               rule,
+               section_size);
+    keep(decompressed);
+  });
+}
+
+// small reads from an indexed 4 MiB stream against decoding all of it
+void bench_range(const options& opts) {
+  constexpr size_t size        = 4 * 1024 * 1024;
+  constexpr size_t read_length = 256;
+
+  constexpr std::string_view full_name = "stream/decompress text 4 MiB";
+  constexpr std::string_view range_name =
+  "stream/decompress_range 256 B of 4 MiB";
+
+  // the compression below is slow, skip it when nothing uses it
+  if (!selected(opts, full_name) && !selected(opts, range_name)) {
+    return;
+  }
+
+  const auto data = create_data(data_kind::text, size);
+
+  std::vector<uint8_t> compressed;
+  stream::compress(data.begin(),
+                   data.end(),
+                   std::back_inserter(compressed),
+                   {.depth = 4, .block_size = 64 * 1024, .indexed = true});
+
+  std::vector<uint8_t> decompressed;
+  decompressed.reserve(size);
+
+  measure(opts, full_name, size, [&] {
+    decompressed.clear();
+    stream::decompress(compressed.begin(),
+                       compressed.end(),
+                       std::back_inserter(decompressed));
+    keep(decompressed);
+  });
+
+  size_t offset = 0;
+  measure(opts, range_name, read_length, [&] {
+    decompressed.clear();
+    offset = (offset + 1'000'003) % (size - read_length);
+    stream::decompress_range(compressed.begin(),
+                             compressed.end(),
+                             std::back_inserter(decompressed),
+                             offset,
+                             read_length);
+    keep(decompressed);
+  });
+}
+
+// 512 B messages with a table trained on other messages against order0
+void bench_dictionary(const options& opts) {
+  constexpr size_t message_size  = 512;
+  constexpr size_t message_count = 64;
+
+  constexpr std::string_view order0_name = "compress/order0 text 512 B";
+  constexpr std::string_view compress_name =
+  "compress/dictionary text 512 B";
+  constexpr std::string_view decompress_name =
+  "decompress/dictionary text 512 B";
+
+  // training runs the SOCA search, skip it when nothing uses it
+  if (!selected(opts, order0_name) && !selected(opts, compress_name) &&
+      !selected(opts, decompress_name)) {
+    return;
+  }
+
+  const auto data =
+  create_data(data_kind::text, message_size * (message_count + 1));
+
+  std::vector<std::vector<uint8_t>> samples;
+  for (size_t idx = 0; idx < message_count; ++idx) {
+    samples.emplace_back(data.begin() + idx * message_size,
+                         data.begin() + (idx + 1) * message_size);
+  }
+  const std::vector<uint8_t> message(data.end() - message_size, data.end());
+
+  dictionary::registry registry;
+  registry.insert(tune::train(samples,
+                              1,
+                              {.rules         = {rule},
+                               .section_sizes = {section_size},
+                               .depths        = {8}}));
+  const dictionary::table& table = *registry.find(1);
+
+  std::vector<uint8_t> compressed;
+  std::vector<uint8_t> decompressed;
+  compressed.reserve(message_size * 2);
+  decompressed.reserve(message_size);
+
+  compression_context   order0_context;
+  compression_context   compress_context;
+  decompression_context decompress_context;
+
+  measure(opts, order0_name, message_size, [&] {
+    compressed.clear();
+    compress(message.begin(),
+             message.end(),
+             std::back_inserter(compressed),
+             order0_context,
+             rule,
+             section_size,
+             8);
+    keep(compressed);
+  });
+
+  measure(opts, compress_name, message_size, [&] {
+    compressed.clear();
+    compress(message.begin(),
+             message.end(),
+             std::back_inserter(compressed),
+             compress_context,
+             table);
+    keep(compressed);
+  });
+
+  // decompression input
+  compressed.clear();
+  compress(message.begin(),
+           message.end(),
+           std::back_inserter(compressed),
+           compress_context,
+           table);
+
+  measure(opts, decompress_name, message_size, [&] {
+    decompressed.clear();
+    decompress(compressed.begin(),
+               compressed.end(),
+               std::back_inserter(decompressed),
+               decompress_context,
+               registry);
+    keep(decompressed);
+  });
+}
+
+// 256 KiB of 400 byte records repeating every 16, with and without a memo,
+// which stays warm across calls as over a stream of such records
+void bench_memo(const options& opts) {
+  constexpr size_t size        = 256 * 1024;
+  constexpr size_t record_size = 400;
+
+  const auto records = create_data(data_kind::text, record_size * 16);
+
+  std::vector<uint8_t> data;
+  data.reserve(size);
+  while (data.size() < size) {
+    const size_t offset = data.size() % records.size();
+    data.insert(data.end(),
+                records.begin() + offset,
+                records.begin() + std::min(records.size(),
+                                           offset + size - data.size()));
+  }
+
+  std::vector<uint8_t> compressed;
+  compressed.reserve(size * 2);
+
+  compression_context context;
+  memo::cache         memo;
+
+  measure(opts, "compress/records 256 KiB", size, [&] {
+    compressed.clear();
+    context.memo = nullptr;
+    compress(data.begin(),
+             data.end(),
+             std::back_inserter(compressed),
+             context,
+             rule,
+             section_size);
+    keep(compressed);
+  });
+
+  measure(opts, "compress/memo records 256 KiB", size, [&] {
+    compressed.clear();
+    context.memo = &memo;
+    compress(data.begin(),
+             data.end(),
+             std::back_inserter(compressed),
+             context,
+             rule,
+             section_size);
+    keep(compressed);
+  });
+}
+
+// decompression of random data, where the search keeps many generations for
+// tiny gains, as searched freely, with a penalty per generation and with no
+// generation budget
+void bench_generations(const options& opts) {
+  constexpr size_t size = 256 * 1024;
+
+  const auto data = create_data(data_kind::random, size);
+
+  std::vector<uint8_t> compressed;
+  std::vector<uint8_t> decompressed;
+  compressed.reserve(size * 2);
+  decompressed.reserve(size);
+
+  decompression_context decompress_context;
+
+  struct setting {
+    std::string_view name;
+    double           penalty;
+    size_t           budget;
+  };
+  for (const setting& entry :
+       {setting {"", 0.0, std::numeric_limits<size_t>::max()},
+        setting {"penalty 1 ", 1.0, std::numeric_limits<size_t>::max()},
+        setting {"budget 0 ", 0.0, 0}}) {
+    const auto name =
+    fmt::format("decompress/generations {}random 256 KiB", entry.name);
+    if (!selected(opts, name)) {
+      continue;
+    }
+
+    compression_context compress_context;
+    compress_context.generation_penalty = entry.penalty;
+    compress_context.generation_budget  = entry.budget;
+
+    compressed.clear();
+    compress(data.begin(),
+             data.end(),
+             std::back_inserter(compressed),
+             compress_context,
+             rule,
+             section_size);
+
+    measure(opts, name, size, [&] {
+      decompressed.clear();
+      decompress(compressed.begin(),
+                 compressed.end(),
+                 std::back_inserter(decompressed),
+                 decompress_context,
+                 rule,
+                 section_size);
+      keep(decompressed);
+    });
+  }
+}
+
+// sections of sizes chosen per region against the fixed section size
+void bench_parse(const options& opts) {
+  constexpr size_t size = 64 * 1024;
+
+  const auto data = create_data(data_kind::text, size);
+
+  std::vector<uint8_t> compressed;
+  std::vector<uint8_t> decompressed;
+  compressed.reserve(size * 2);
+  decompressed.reserve(size);
+
+  compression_context   compress_context;
+  decompression_context decompress_context;
+
+  measure(opts, "compress/parse text 64 KiB", size, [&] {
+    compressed.clear();
+    parse::compress(data.begin(),
+                    data.end(),
+                    std::back_inserter(compressed),
+                    compress_context,
+                    rule);
+    keep(compressed);
+  });
+
+  // decompression input
+  compressed.clear();
+  parse::compress(data.begin(),
+                  data.end(),
+                  std::back_inserter(compressed),
+                  compress_context,
+                  rule);
+
+  measure(opts, "decompress/parse text 64 KiB", size, [&] {
+    decompressed.clear();
+    parse::decompress(compressed.begin(),
+                      compressed.end(),
+                      std::back_inserter(decompressed),
+                      decompress_context,
+                      rule);
+    keep(decompressed);
+  });
+}
+
+}    // namespace
+
+void run_end_to_end(const options& opts) {
+  bench_range(opts);
+  bench_dictionary(opts);
+  bench_memo(opts);
+  bench_generations(opts);
+  bench_parse(opts);
+
+  for (const auto kind : {data_kind::text,
+                          data_kind::random,
+                          data_kind::zeros,
+                          data_kind::ramp}) {
+    for (const size_t size : {1024, 16 * 1024, 256 * 1024}) {
+      bench_size(opts, kind, size);
+    }
+  }
+}
+
+}    // namespace bench
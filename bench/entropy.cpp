@@ -0,0 +1,216 @@
+#include "HUFFMAN.hpp"
+#include "ORDER1.hpp"
+#include "UTIL.hpp"
+#include "bench.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+namespace {
+
+constexpr size_t buffer_size = 64 * 1024;
+
+// HISTOGRAM v
+
+void bench_histogram(const options& opts) {
+  const auto data = create_data(data_kind::text, buffer_size);
+
+  std::array<size_t, 256> freq {};
+
+  measure(opts, "histogram/count", buffer_size, [&] {
+    freq = {};
+    for (const uint8_t byte : data) {
+      ++freq[byte];
+    }
+    keep(freq);
+  });
+
+  // bytes are the 256 bins
+  measure(opts, "histogram/calculate_entropy", freq.size(), [&] {
+    keep(util::calculate_entropy(freq.begin(), freq.end()));
+  });
+
+  measure(opts, "histogram/count_bytes", buffer_size, [&] {
+    freq = {};
+    util::count_bytes(data.begin(), data.end(), freq);
+    keep(freq);
+  });
+
+  // two search steps: half a section replaced and restored, entropy of each
+  util::histogram histogram;
+  histogram.add(data.begin(), data.end());
+  measure(opts, "histogram/replace and entropy", 512, [&] {
+    for (size_t idx = 0; idx < 512; ++idx) {
+      histogram.replace(data[idx], data[idx + 512]);
+    }
+    keep(histogram.entropy());
+    for (size_t idx = 0; idx < 512; ++idx) {
+      histogram.replace(data[idx + 512], data[idx]);
+    }
+    keep(histogram.entropy());
+  });
+}
+
+// HISTOGRAM ^
+// HUFFMAN v
+
+void bench_huffman(const options& opts) {
+  for (const auto kind : {data_kind::text, data_kind::random}) {
+    const auto data = create_data(kind, buffer_size);
+
+    std::vector<uint8_t> encoded;
+    std::vector<uint8_t> decoded;
+    encoded.reserve(buffer_size * 2);
+    decoded.reserve(buffer_size);
+
+    huffman::encode_context encode_context;
+    huffman::decode_context decode_context;
+
+    const auto suffix = std::string(name_of(kind));
+
+    measure(opts, "huffman/encode " + suffix, buffer_size, [&] {
+      encoded.clear();
+      huffman::encode(data.begin(),
+                      data.end(),
+                      std::back_inserter(encoded),
+                      encode_context);
+      keep(encoded);
+    });
+
+    measure(opts, "huffman/decode " + suffix, buffer_size, [&] {
+      decoded.clear();
+      huffman::decode(encoded.begin(),
+                      encoded.end(),
+                      std::back_inserter(decoded),
+                      decode_context);
+      keep(decoded);
+    });
+
+    // tree setup dominates a message sized block
+    std::array<size_t, 256> freq {};
+    util::count_bytes(data.begin(), data.end(), freq);
+    measure(opts, "huffman/build_tree " + suffix, 256, [&] {
+      impl::huffman::build_tree(encode_context.tree, freq);
+      keep(encode_context.tree);
+    });
+
+    measure(opts, "huffman/encode 256 B " + suffix, 256, [&] {
+      encoded.clear();
+      huffman::encode(data.begin(),
+                      data.begin() + 256,
+                      std::back_inserter(encoded),
+                      encode_context);
+      keep(encoded);
+    });
+  }
+}
+
+// large single block, all cores against the serial encode
+void bench_huffman_parallel(const options& opts) {
+  constexpr size_t block_size = 16 * 1024 * 1024;
+
+  const auto data = create_data(data_kind::text, block_size);
+
+  std::vector<uint8_t> encoded;
+  encoded.reserve(block_size);
+
+  huffman::encode_context encode_context;
+
+  for (const size_t threads : {1, 0}) {
+    measure(opts,
+            fmt::format("huffman/encode_parallel {} threads",
+                        threads == 0 ? std::string {"all"}
+                                     : std::to_string(threads)),
+            block_size,
+            [&] {
+      encoded.clear();
+      huffman::encode_parallel(data.begin(),
+                               data.end(),
+                               std::back_inserter(encoded),
+                               encode_context,
+                               threads);
+      keep(encoded);
+    });
+  }
+}
+
+// against order-0 huffman above, decode is the cost of the model
+void bench_order1(const options& opts) {
+  for (const auto kind : {data_kind::text, data_kind::random}) {
+    const auto data = create_data(kind, buffer_size);
+
+    std::vector<uint8_t> encoded;
+    std::vector<uint8_t> decoded;
+    encoded.reserve(buffer_size * 2);
+    decoded.reserve(buffer_size);
+
+    order1::encode_context encode_context;
+    order1::decode_context decode_context;
+
+    const auto suffix = std::string(name_of(kind));
+
+    measure(opts, "order1/encode " + suffix, buffer_size, [&] {
+      encoded.clear();
+      order1::encode(data.begin(),
+                     data.end(),
+                     std::back_inserter(encoded),
+                     encode_context);
+      keep(encoded);
+    });
+
+    measure(opts, "order1/decode " + suffix, buffer_size, [&] {
+      decoded.clear();
+      order1::decode(encoded.begin(),
+                     encoded.end(),
+                     std::back_inserter(decoded),
+                     decode_context);
+      keep(decoded);
+    });
+  }
+}
+
+// HUFFMAN ^
+// BIT IO v
+
+void bench_bit_io(const options& opts) {
+  const auto data = create_data(data_kind::random, buffer_size);
+
+  std::vector<uint8_t> written(buffer_size);
+  std::vector<uint8_t> read(buffer_size);
+
+  measure(opts, "bit io/write_byte", buffer_size, [&] {
+    util::bit_writer writer {written.begin()};
+    for (const uint8_t byte : data) {
+      writer.write_byte(byte);
+    }
+    keep(written);
+  });
+
+  measure(opts, "bit io/read_byte", buffer_size, [&] {
+    util::bit_reader reader {written.cbegin()};
+    for (auto& byte : read) {
+      byte = reader.read_byte();
+    }
+    keep(read);
+  });
+}
+
+// BIT IO ^
+
+}    // namespace
+
+void run_entropy(const options& opts) {
+  bench_histogram(opts);
+  bench_huffman(opts);
+  bench_huffman_parallel(opts);
+  bench_order1(opts);
+  bench_bit_io(opts);
+}
+
+}    // namespace bench
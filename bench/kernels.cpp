@@ -0,0 +1,269 @@
+#include "COMPRESS.hpp"
+#include "SHUFFLE.hpp"
+#include "SOCA.hpp"
+#include "TRANSFORM.hpp"
+#include "UTIL.hpp"
+#include "bench.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+namespace {
+
+constexpr uint8_t rule         = 30;
+constexpr size_t  section_size = 40;
+constexpr size_t  buffer_size  = 40 * 1024;
+
+// SOCA v
+
+void bench_iterator_kernels(const options& opts) {
+  auto data = create_data(data_kind::random, buffer_size);
+
+  measure(opts, "soca/forward template rule", buffer_size, [&] {
+    for (auto itr = data.begin(); itr != data.end(); itr += section_size) {
+      soca::forward_front<rule>(itr, itr + section_size);
+      soca::forward_back<rule>(itr, itr + section_size);
+    }
+    keep(data);
+  });
+
+  measure(opts, "soca/forward runtime rule", buffer_size, [&] {
+    for (auto itr = data.begin(); itr != data.end(); itr += section_size) {
+      soca::forward_front(itr, itr + section_size, rule);
+      soca::forward_back(itr, itr + section_size, rule);
+    }
+    keep(data);
+  });
+
+  measure(opts, "soca/reverse template rule", buffer_size, [&] {
+    for (auto itr = data.begin(); itr != data.end(); itr += section_size) {
+      soca::reverse_back<rule>(itr, itr + section_size);
+      soca::reverse_front<rule>(itr, itr + section_size);
+    }
+    keep(data);
+  });
+
+  measure(opts, "soca/reverse runtime rule", buffer_size, [&] {
+    for (auto itr = data.begin(); itr != data.end(); itr += section_size) {
+      soca::reverse_back(itr, itr + section_size, rule);
+      soca::reverse_front(itr, itr + section_size, rule);
+    }
+    keep(data);
+  });
+}
+
+void bench_fixed_kernels(const options& opts) {
+  auto data = create_data(data_kind::random, buffer_size);
+
+  measure(opts, "soca/fixed_section template rule", buffer_size, [&] {
+    for (auto itr = data.begin(); itr != data.end(); itr += section_size) {
+      soca::fixed_section<section_size> state {itr};
+      state.forward_front<rule>();
+      state.forward_back<rule>();
+      state.store(itr);
+    }
+    keep(data);
+  });
+
+  measure(opts, "soca/fixed_section runtime rule", buffer_size, [&] {
+    for (auto itr = data.begin(); itr != data.end(); itr += section_size) {
+      soca::fixed_section<section_size> state {itr};
+      state.forward_front(rule);
+      state.forward_back(rule);
+      state.store(itr);
+    }
+    keep(data);
+  });
+}
+
+// max_count generations of additive rule 90 back, stepped against jumped
+void bench_jump_kernels(const options& opts) {
+  constexpr uint8_t additive_rule = 90;
+  constexpr uint8_t steps         = impl::compress::max_count;
+
+  auto data = create_data(data_kind::random, buffer_size);
+
+  measure(opts, "soca/reverse steps additive rule", buffer_size, [&] {
+    for (auto itr = data.begin(); itr != data.end(); itr += section_size) {
+      for (uint8_t generation = steps; generation > 0; --generation) {
+        if (generation % 2 == 0) {
+          soca::reverse_back<additive_rule>(itr, itr + section_size);
+        } else {
+          soca::reverse_front<additive_rule>(itr, itr + section_size);
+        }
+      }
+    }
+    keep(data);
+  });
+
+  measure(opts, "soca/reverse jump additive rule", buffer_size, [&] {
+    for (auto itr = data.begin(); itr != data.end(); itr += section_size) {
+      soca::jump_reverse(itr, itr + section_size, additive_rule, steps, steps);
+    }
+    keep(data);
+  });
+}
+
+// SOCA ^
+// SECTION SEARCH v
+
+template<typename Search>
+void bench_search(const options& opts, std::string_view name, Search search) {
+  const auto input = create_data(data_kind::text, buffer_size);
+  auto       data  = input;
+
+  measure(opts, name, buffer_size, [&] {
+    data = input;
+    util::histogram histogram;
+    histogram.add(data.begin(), data.end());
+    for (auto itr = data.begin(); itr != data.end(); itr += section_size) {
+      keep(search(histogram, itr));
+    }
+  });
+}
+
+void bench_section_search(const options& opts) {
+  bench_search(opts, "section/template rule", [](auto& histogram, auto itr) {
+    return impl::compress::section<rule>(histogram, itr, itr + section_size);
+  });
+
+  bench_search(opts,
+               "section/template rule and size",
+               [](auto& histogram, auto itr) {
+    return impl::compress::section<rule, section_size>(histogram, itr);
+  });
+
+  bench_search(opts, "section/runtime rule", [](auto& histogram, auto itr) {
+    return impl::compress::section(histogram,
+                                   itr,
+                                   itr + section_size,
+                                   rule);
+  });
+
+  // the runtime compress() path, steps through a function pointer
+  const auto& kernels =
+  impl::compress::dispatch_table<>[*impl::compress::dispatch_index(
+  rule, section_size)];
+
+  bench_search(opts, "section/dispatch table", [&](auto& histogram, auto itr) {
+    return kernels.search(
+    histogram, itr, itr + section_size, impl::compress::max_count, 0.0);
+  });
+}
+
+// max_count generations back per section, as decompression of the deepest
+// searched sections
+void bench_section_reverse(const options& opts) {
+  constexpr uint8_t count = impl::compress::max_count;
+
+  auto data = create_data(data_kind::random, buffer_size);
+
+  measure(opts, "section reverse/template rule and size", buffer_size, [&] {
+    for (auto itr = data.begin(); itr != data.end(); itr += section_size) {
+      impl::compress::section_decompress<rule, section_size>(itr, count);
+    }
+    keep(data);
+  });
+
+  const auto& kernels =
+  impl::compress::dispatch_table<>[*impl::compress::dispatch_index(
+  rule, section_size)];
+
+  measure(opts, "section reverse/dispatch table", buffer_size, [&] {
+    for (auto itr = data.begin(); itr != data.end(); itr += section_size) {
+      kernels.reverse(itr, itr + section_size, count);
+    }
+    keep(data);
+  });
+}
+
+// SECTION SEARCH ^
+// SHUFFLE v
+
+void bench_shuffle(const options& opts) {
+  constexpr size_t size = 64 * 1024;
+
+  const auto           data = create_data(data_kind::ramp, size);
+  std::vector<uint8_t> shuffled(size);
+  std::vector<uint8_t> restored(size);
+
+  for (const auto mode : {shuffle::mode::bytes, shuffle::mode::bits}) {
+    const std::string name = mode == shuffle::mode::bytes ? "bytes" : "bits";
+
+    // 4 takes the fixed width path, 3 the generic one
+    for (const size_t width : {3, 4}) {
+      measure(opts,
+              fmt::format("shuffle/apply {} width {}", name, width),
+              size,
+              [&] {
+        shuffle::apply(mode, data, shuffled, width);
+        keep(shuffled);
+      });
+
+      measure(opts,
+              fmt::format("shuffle/revert {} width {}", name, width),
+              size,
+              [&] {
+        shuffle::revert(mode, shuffled, restored, width);
+        keep(restored);
+      });
+    }
+  }
+}
+
+// SHUFFLE ^
+// TRANSFORM v
+
+void bench_transform(const options& opts) {
+  constexpr size_t size = 64 * 1024;
+
+  auto data = create_data(data_kind::text, size);
+
+  const std::pair<std::string_view, transform::stage> stages[] {
+    {"delta", {.type = transform::kind::delta}},
+    {"stride_delta 14",
+     {.type = transform::kind::stride_delta, .distance = 14}},
+    {"stride_delta 64",
+     {.type = transform::kind::stride_delta, .distance = 64}},
+    {"move_to_front", {.type = transform::kind::move_to_front}},
+  };
+
+  // apply and revert together so every call sees the same data, the speed
+  // of move_to_front depends on it
+  for (const auto& [name, stage] : stages) {
+    transform::chain chain {std::span {&stage, 1}};
+
+    measure(opts,
+            fmt::format("transform/apply and revert {}", name),
+            size,
+            [&] {
+      chain.apply(data);
+      chain.revert(data);
+      keep(data);
+    });
+  }
+}
+
+// TRANSFORM ^
+
+}    // namespace
+
+void run_kernels(const options& opts) {
+  bench_iterator_kernels(opts);
+  bench_fixed_kernels(opts);
+  bench_jump_kernels(opts);
+  bench_section_search(opts);
+  bench_section_reverse(opts);
+  bench_shuffle(opts);
+  bench_transform(opts);
+}
+
+}    // namespace bench
@@ -0,0 +1,52 @@
+#include "bench.hpp"
+#include <fmt/core.h>
+
+#include <cstdlib>
+#include <string_view>
+
+// usage: cacompress_bench [--filter name] [--warmup n] [--repetitions n]
+// corpus regression instead of the benchmarks when --report or --baseline is
+// given: [--report out.json] [--baseline base.json] [--seed n]
+// [--dataset-size bytes] [--ratio-tolerance x] [--speed-tolerance x]
+int main(int argc, char** argv) {
+  bench::options            opts;
+  bench::regression_options regression;
+
+  for (int arg = 1; arg + 1 < argc; arg += 2) {
+    const std::string_view flag  = argv[arg];
+    const char*            value = argv[arg + 1];
+
+    if (flag == "--filter") {
+      opts.filter = value;
+    } else if (flag == "--warmup") {
+      opts.warmup = std::strtoul(value, nullptr, 10);
+    } else if (flag == "--repetitions") {
+      opts.repetitions = std::strtoul(value, nullptr, 10);
+    } else if (flag == "--report") {
+      regression.report = value;
+    } else if (flag == "--baseline") {
+      regression.baseline = value;
+    } else if (flag == "--seed") {
+      regression.seed = std::strtoul(value, nullptr, 10);
+    } else if (flag == "--dataset-size") {
+      regression.dataset_size = std::strtoul(value, nullptr, 10);
+    } else if (flag == "--ratio-tolerance") {
+      regression.ratio_tolerance = std::strtod(value, nullptr);
+    } else if (flag == "--speed-tolerance") {
+      regression.speed_tolerance = std::strtod(value, nullptr);
+    } else {
+      fmt::println("unknown option {}", flag);
+      return 1;
+    }
+  }
+
+  if (!regression.report.empty() || !regression.baseline.empty()) {
+    return bench::run_regression(opts, regression);
+  }
+
+  bench::run_kernels(opts);
+  bench::run_entropy(opts);
+  bench::run_end_to_end(opts);
+
+  return bench::run_context(opts);
+}
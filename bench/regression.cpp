@@ -0,0 +1,672 @@
+#include "COMPRESS.hpp"
+#include "LEVEL.hpp"
+#include "PARSE.hpp"
+#include "SOCA.hpp"
+#include "STREAM.hpp"
+#include "TRANSFORM.hpp"
+#include "TUNE.hpp"
+#include "bench.hpp"
+#include "corpus.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+namespace {
+
+struct dataset_result {
+  std::string name;
+  size_t      size;
+  size_t      compressed_size;
+  double      ratio;
+  double      compress_mbps;
+  double      decompress_mbps;
+  bool        round_trip;
+};
+
+dataset_result run_dataset(const options&            opts,
+                           const corpus::dataset&    dataset,
+                           const stream::parameters& params) {
+  std::vector<uint8_t> compressed;
+  std::vector<uint8_t> decompressed;
+
+  const auto compress_stats = run(opts, [&] {
+    compressed.clear();
+    stream::compress(dataset.data.begin(),
+                     dataset.data.end(),
+                     std::back_inserter(compressed),
+                     params);
+  });
+
+  const auto decompress_stats = run(opts, [&] {
+    decompressed.clear();
+    stream::decompress(compressed.begin(),
+                       compressed.end(),
+                       std::back_inserter(decompressed));
+  });
+
+  const auto size = static_cast<double>(dataset.data.size());
+  return {.name            = dataset.name,
+          .size            = dataset.data.size(),
+          .compressed_size = compressed.size(),
+          .ratio           = size / static_cast<double>(compressed.size()),
+          .compress_mbps   = size / compress_stats.median / 1e6,
+          .decompress_mbps = size / decompress_stats.median / 1e6,
+          .round_trip      = decompressed == dataset.data};
+}
+
+std::string to_json(const regression_options&         regression,
+                    const stream::parameters&          params,
+                    const std::vector<dataset_result>& results) {
+  std::string json = fmt::format(
+  "{{\n  \"seed\": {},\n  \"dataset_size\": {},\n"
+  "  \"parameters\": {{\"rule\": {}, \"section_size\": {}, \"depth\": {}}},\n"
+  "  \"datasets\": [\n",
+  regression.seed,
+  regression.dataset_size,
+  params.rule,
+  params.section_size,
+  params.depth);
+
+  for (size_t idx = 0; idx < results.size(); ++idx) {
+    const auto& result = results[idx];
+    json += fmt::format(
+    "    {{\"name\": \"{}\", \"size\": {}, \"compressed_size\": {}, "
+    "\"ratio\": {:.6f}, \"compress_mbps\": {:.3f}, "
+    "\"decompress_mbps\": {:.3f}}}{}\n",
+    result.name,
+    result.size,
+    result.compressed_size,
+    result.ratio,
+    result.compress_mbps,
+    result.decompress_mbps,
+    idx + 1 == results.size() ? "" : ",");
+  }
+
+  return json + "  ]\n}\n";
+}
+
+// ROUND TRIPS v
+// every dataset through the other modes of the API, output is not timed
+
+/***
+ * @brief false if decompress(compress(data), data.size()) differs from data
+ * for any dataset, the failing datasets are printed
+ * @note compress and decompress take and return byte vectors, the size is
+ * for decoders that need it. An exception counts as a failed round trip.
+ ***/
+template<typename Compress, typename Decompress>
+bool round_trip(std::string_view                    mode,
+                const std::vector<corpus::dataset>& datasets,
+                Compress                            compress,
+                Decompress                          decompress) {
+  bool passed = true;
+  for (const auto& dataset : datasets) {
+    bool same = false;
+    try {
+      same = decompress(compress(dataset.data), dataset.data.size()) ==
+             dataset.data;
+    } catch (const std::exception& error) {
+      fmt::println("{} {}: {}", mode, dataset.name, error.what());
+    }
+
+    if (!same) {
+      fmt::println("{} {}: round trip FAILED", mode, dataset.name);
+      passed = false;
+    }
+  }
+  return passed;
+}
+
+auto stream_compress(stream::parameters params) {
+  return [params = std::move(params)](const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> result;
+    stream::compress(
+    data.begin(), data.end(), std::back_inserter(result), params);
+    return result;
+  };
+}
+
+std::vector<uint8_t> stream_decompress(const std::vector<uint8_t>& compressed,
+                                       size_t /*size*/) {
+  std::vector<uint8_t> result;
+  stream::decompress(
+  compressed.begin(), compressed.end(), std::back_inserter(result));
+  return result;
+}
+
+// stream::decompress_range of three pieces, joined
+std::vector<uint8_t> range_decompress(const std::vector<uint8_t>& compressed,
+                                      size_t                      size) {
+  std::vector<uint8_t> result;
+  for (size_t piece = 0; piece < 3; ++piece) {
+    const size_t offset = size * piece / 3;
+    stream::decompress_range(compressed.begin(),
+                             compressed.end(),
+                             std::back_inserter(result),
+                             offset,
+                             size * (piece + 1) / 3 - offset);
+  }
+  return result;
+}
+
+std::vector<uint8_t> view_decompress(const std::vector<uint8_t>& compressed,
+                                     size_t /*size*/) {
+  std::vector<uint8_t> result;
+  for (const uint8_t byte :
+       stream::decompress_view {compressed.begin(), compressed.end()}) {
+    result.push_back(byte);
+  }
+  return result;
+}
+
+// compress() and decompress() with the rule and section size at run time
+bool runtime_round_trip(std::string_view                    mode,
+                        const std::vector<corpus::dataset>& datasets,
+                        compression_context&                compress_context,
+                        decompression_context&              decompress_context,
+                        uint8_t                             rule,
+                        size_t                              section_size,
+                        uint8_t                             depth) {
+  return round_trip(
+  mode,
+  datasets,
+  [&](const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> result;
+    compress(data.begin(),
+             data.end(),
+             std::back_inserter(result),
+             compress_context,
+             rule,
+             section_size,
+             depth);
+    return result;
+  },
+  [&](const std::vector<uint8_t>& compressed, size_t /*size*/) {
+    std::vector<uint8_t> result;
+    decompress(compressed.begin(),
+               compressed.end(),
+               std::back_inserter(result),
+               decompress_context,
+               rule,
+               section_size);
+    return result;
+  });
+}
+
+// additive rules soca::jump_forward and jump_reverse take
+constexpr std::array<uint8_t, 2> additive_rules {90, 150};
+
+/***
+ * @brief false if a jump of an additive rule differs from stepping, over 0 to
+ * impl::compress::max_count generations and section sizes up to
+ * soca::max_jump_size, the failing jumps are printed
+ * @note a jump back must also restore the section. Without soca::fast_jump
+ * nothing jumps and nothing is checked.
+ ***/
+bool check_jumps() {
+  if (!soca::fast_jump()) {
+    return true;
+  }
+
+  std::mt19937 gen {1};
+  bool         passed = true;
+  for (const uint8_t rule : additive_rules) {
+    for (const size_t size : {size_t {8}, size_t {40}, soca::max_jump_size}) {
+      for (const size_t generation : {size_t {0}, size_t {1}}) {
+        for (size_t steps = 0; steps <= impl::compress::max_count; ++steps) {
+          std::vector<uint8_t> start(size);
+          for (auto& byte : start) {
+            byte = static_cast<uint8_t>(gen());
+          }
+
+          auto stepped = start;
+          for (size_t step = 1; step <= steps; ++step) {
+            if ((generation + step) % 2 == 1) {
+              soca::forward_front(stepped.begin(), stepped.end(), rule);
+            } else {
+              soca::forward_back(stepped.begin(), stepped.end(), rule);
+            }
+          }
+
+          auto       jumped  = start;
+          const bool forward = soca::jump_forward(
+          jumped.begin(), jumped.end(), rule, generation, steps);
+
+          auto       undone  = jumped;
+          const bool reverse = soca::jump_reverse(
+          undone.begin(), undone.end(), rule, generation + steps, steps);
+
+          if (!forward || !reverse || jumped != stepped || undone != start) {
+            fmt::println("jump rule {} size {} generation {} steps {} FAILED",
+                         rule,
+                         size,
+                         generation,
+                         steps);
+            passed = false;
+          }
+        }
+      }
+    }
+  }
+  return passed;
+}
+
+/***
+ * @brief false if a transform::pipeline transforms a dataset other than the
+ * transform::chain of the same stages, or fails to revert it, the failing
+ * datasets are printed
+ ***/
+bool check_pipeline(const std::vector<corpus::dataset>& datasets) {
+  const std::array<transform::stage, 4> stages {{
+    {.type = transform::kind::delta},
+    {.type = transform::kind::stride_delta, .distance = 4},
+    {.type = transform::kind::xor_record, .distance = 8},
+    {.type = transform::kind::move_to_front},
+  }};
+  transform::chain    chain {stages};
+  transform::pipeline pipeline {transform::delta {},
+                                transform::stride_delta {4},
+                                transform::xor_record {8},
+                                transform::move_to_front {}};
+
+  bool passed = true;
+  for (const auto& dataset : datasets) {
+    auto chained = dataset.data;
+    auto piped   = dataset.data;
+    chain.apply(chained);
+    pipeline.apply(piped);
+
+    const bool same = piped == chained;
+    pipeline.revert(piped);
+
+    if (!same || piped != dataset.data) {
+      fmt::println("pipeline {}: FAILED", dataset.name);
+      passed = false;
+    }
+  }
+  return passed;
+}
+
+// every level, then the stream modes, views and ranges, and the runtime,
+// dictionary and parse APIs, each on its own
+bool check_round_trips(const std::vector<corpus::dataset>& datasets) {
+  bool passed = true;
+
+  for (int number = level::min_level; number <= level::max_level; ++number) {
+    const auto compress = [number](const std::vector<uint8_t>& data) {
+      std::vector<uint8_t> result;
+      level::compress(
+      data.begin(), data.end(), std::back_inserter(result), number);
+      return result;
+    };
+    passed = round_trip(fmt::format("level {}", number),
+                        datasets,
+                        compress,
+                        stream_decompress) &&
+             passed;
+  }
+
+  // blocks of random data are stored
+  const std::vector<std::pair<std::string_view, stream::parameters>> modes {
+    {"4 KiB blocks", {.depth = 8, .block_size = 4096}},
+    {"shuffle bytes",
+     {.depth = 8, .shuffle = shuffle::mode::bytes, .element_width = 4}},
+    {"shuffle bits",
+     {.depth = 8, .shuffle = shuffle::mode::bits, .element_width = 4}},
+    {"transforms",
+     {.depth      = 8,
+      .transforms = {{.type = transform::kind::delta},
+                     {.type = transform::kind::move_to_front}}}},
+    {"order1", {.depth = 8, .entropy = entropy_model::order1}},
+    {"without runs", {.depth = 8, .run_tokens = false}},
+  };
+  for (const auto& [mode, params] : modes) {
+    passed =
+    round_trip(mode, datasets, stream_compress(params), stream_decompress) &&
+    passed;
+  }
+
+  const auto indexed =
+  stream_compress({.depth = 8, .block_size = 4096, .indexed = true});
+  passed = round_trip("view", datasets, indexed, view_decompress) && passed;
+  passed = round_trip("range", datasets, indexed, range_decompress) && passed;
+
+  constexpr uint8_t rule         = 220;
+  constexpr size_t  section_size = 40;
+  constexpr uint8_t depth        = 8;
+
+  compression_context   compress_context;
+  decompression_context decompress_context;
+  passed = runtime_round_trip("runtime",
+                              datasets,
+                              compress_context,
+                              decompress_context,
+                              rule,
+                              section_size,
+                              depth) &&
+           passed;
+
+  compress_context.shuffle         = shuffle::mode::bits;
+  compress_context.element_width   = 4;
+  decompress_context.shuffle       = shuffle::mode::bits;
+  decompress_context.element_width = 4;
+  passed = runtime_round_trip("runtime shuffle bits",
+                              datasets,
+                              compress_context,
+                              decompress_context,
+                              rule,
+                              section_size,
+                              depth) &&
+           passed;
+
+  // additive rules jump in the search and on decompression: dispatched
+  // sections through static_rule, other sizes up to soca::max_jump_size
+  // through dynamic_rule, larger ones are stepped
+  compression_context   additive_context;
+  decompression_context unadditive_context;
+  for (const uint8_t additive_rule : additive_rules) {
+    for (const size_t size : {size_t {40}, size_t {200}, size_t {300}}) {
+      passed = runtime_round_trip(
+               fmt::format("runtime rule {} sections {}", additive_rule, size),
+               datasets,
+               additive_context,
+               unadditive_context,
+               additive_rule,
+               size,
+               impl::compress::max_count) &&
+               passed;
+    }
+  }
+
+  // the table is trained on the start of every dataset
+  std::vector<std::vector<uint8_t>> samples;
+  for (const auto& dataset : datasets) {
+    samples.emplace_back(
+    dataset.data.begin(),
+    dataset.data.begin() + std::min<ptrdiff_t>(std::ssize(dataset.data), 4096));
+  }
+  dictionary::registry registry;
+  registry.insert(tune::train(samples,
+                              1,
+                              {.rules         = {rule},
+                               .section_sizes = {section_size},
+                               .depths        = {depth}}));
+
+  compression_context   dictionary_context;
+  decompression_context undictionary_context;
+  passed = round_trip(
+           "dictionary",
+           datasets,
+           [&](const std::vector<uint8_t>& data) {
+             std::vector<uint8_t> result;
+             compress(data.begin(),
+                      data.end(),
+                      std::back_inserter(result),
+                      dictionary_context,
+                      *registry.find(1));
+             return result;
+           },
+           [&](const std::vector<uint8_t>& compressed, size_t /*size*/) {
+             std::vector<uint8_t> result;
+             decompress(compressed.begin(),
+                        compressed.end(),
+                        std::back_inserter(result),
+                        undictionary_context,
+                        registry);
+             return result;
+           }) &&
+           passed;
+
+  compression_context   parse_context;
+  decompression_context unparse_context;
+
+  const auto parse_compress = [&](const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> result;
+    parse::compress(data.begin(),
+                    data.end(),
+                    std::back_inserter(result),
+                    parse_context,
+                    rule,
+                    impl::compress::dispatch_section_sizes,
+                    depth);
+    return result;
+  };
+  const auto parse_decompress = [&](const std::vector<uint8_t>& compressed,
+                                    size_t /*size*/) {
+    std::vector<uint8_t> result;
+    parse::decompress(compressed.begin(),
+                      compressed.end(),
+                      std::back_inserter(result),
+                      unparse_context,
+                      rule);
+    return result;
+  };
+  passed =
+  round_trip("parse", datasets, parse_compress, parse_decompress) && passed;
+
+  parse_context.shuffle         = shuffle::mode::bytes;
+  parse_context.element_width   = 4;
+  unparse_context.shuffle       = shuffle::mode::bytes;
+  unparse_context.element_width = 4;
+  passed = round_trip("parse shuffle bytes",
+                      datasets,
+                      parse_compress,
+                      parse_decompress) &&
+           passed;
+
+  return passed;
+}
+
+// ROUND TRIPS ^
+// REPORT READING v
+// reads the reports to_json writes, not general JSON
+
+std::optional<double> number_field(std::string_view json,
+                                   std::string_view key) {
+  const auto quoted = fmt::format("\"{}\":", key);
+  const auto found  = json.find(quoted);
+  if (found == std::string_view::npos) {
+    return std::nullopt;
+  }
+
+  const std::string rest {json.substr(found + quoted.size())};
+  char*             end   = nullptr;
+  const double      value = std::strtod(rest.c_str(), &end);
+  if (end == rest.c_str()) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+std::optional<std::string> string_field(std::string_view json,
+                                        std::string_view key) {
+  const auto quoted = fmt::format("\"{}\": \"", key);
+  const auto found  = json.find(quoted);
+  if (found == std::string_view::npos) {
+    return std::nullopt;
+  }
+
+  const auto begin = found + quoted.size();
+  const auto end   = json.find('"', begin);
+  if (end == std::string_view::npos) {
+    return std::nullopt;
+  }
+  return std::string {json.substr(begin, end - begin)};
+}
+
+struct baseline {
+  double                      seed;
+  double                      dataset_size;
+  std::vector<dataset_result> results;
+};
+
+std::optional<baseline> read_baseline(const std::string& path) {
+  std::ifstream file {path};
+  if (!file) {
+    return std::nullopt;
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  const std::string json = buffer.str();
+
+  const auto seed         = number_field(json, "seed");
+  const auto dataset_size = number_field(json, "dataset_size");
+  if (!seed || !dataset_size) {
+    return std::nullopt;
+  }
+
+  baseline result {.seed = *seed, .dataset_size = *dataset_size, .results = {}};
+
+  // one object per dataset line
+  for (size_t begin = json.find("{\"name\""); begin != std::string::npos;
+       begin        = json.find("{\"name\"", begin + 1)) {
+    const std::string_view object {json.data() + begin,
+                                   json.find('}', begin) - begin};
+
+    const auto name            = string_field(object, "name");
+    const auto ratio           = number_field(object, "ratio");
+    const auto compress_mbps   = number_field(object, "compress_mbps");
+    const auto decompress_mbps = number_field(object, "decompress_mbps");
+    if (!name || !ratio || !compress_mbps || !decompress_mbps) {
+      return std::nullopt;
+    }
+
+    result.results.push_back({.name            = *name,
+                              .size            = 0,
+                              .compressed_size = 0,
+                              .ratio           = *ratio,
+                              .compress_mbps   = *compress_mbps,
+                              .decompress_mbps = *decompress_mbps,
+                              .round_trip      = true});
+  }
+
+  return result;
+}
+
+// REPORT READING ^
+
+// relative change of current against base, negative for a loss
+double change(double base, double current) {
+  return base > 0.0 ? (current - base) / base : 0.0;
+}
+
+bool compare(const regression_options&          regression,
+             const baseline&                    base,
+             const std::vector<dataset_result>& results) {
+  if (base.seed != regression.seed ||
+      base.dataset_size != static_cast<double>(regression.dataset_size)) {
+    fmt::println("baseline corpus differs: seed {} size {}",
+                 base.seed,
+                 base.dataset_size);
+    return false;
+  }
+
+  bool passed = true;
+
+  fmt::println("{:<10} {:>8} {:>9} {:>11} {:>11}  status",
+               "dataset",
+               "ratio",
+               "change",
+               "comp MB/s",
+               "decomp MB/s");
+
+  for (const auto& result : results) {
+    const auto found = std::find_if(base.results.begin(),
+                                    base.results.end(),
+                                    [&](const dataset_result& entry) {
+      return entry.name == result.name;
+    });
+    if (found == base.results.end()) {
+      fmt::println("{:<10} not in baseline", result.name);
+      continue;
+    }
+
+    const double ratio_change      = change(found->ratio, result.ratio);
+    const double compress_change   = change(found->compress_mbps,
+                                          result.compress_mbps);
+    const double decompress_change = change(found->decompress_mbps,
+                                            result.decompress_mbps);
+
+    const bool ratio_ok = ratio_change >= -regression.ratio_tolerance;
+    const bool speed_ok = compress_change >= -regression.speed_tolerance &&
+                          decompress_change >= -regression.speed_tolerance;
+
+    passed = passed && ratio_ok && speed_ok;
+
+    fmt::println("{:<10} {:>8.4f} {:>+8.2f}% {:>+10.1f}% {:>+10.1f}%  {}",
+                 result.name,
+                 result.ratio,
+                 ratio_change * 100.0,
+                 compress_change * 100.0,
+                 decompress_change * 100.0,
+                 !ratio_ok  ? "RATIO REGRESSION"
+                 : !speed_ok ? "SPEED REGRESSION"
+                             : "ok");
+  }
+
+  return passed;
+}
+
+}    // namespace
+
+int run_regression(const options& opts, const regression_options& regression) {
+  const stream::parameters params {};
+  const auto               datasets =
+  corpus::generate(regression.dataset_size, regression.seed);
+
+  bool passed = true;
+
+  std::vector<dataset_result> results;
+  for (const auto& dataset : datasets) {
+    results.push_back(run_dataset(opts, dataset, params));
+    if (!results.back().round_trip) {
+      fmt::println("{}: round trip FAILED", dataset.name);
+      passed = false;
+    }
+  }
+
+  passed = check_round_trips(datasets) && passed;
+  passed = check_pipeline(datasets) && passed;
+  passed = check_jumps() && passed;
+
+  const std::string json = to_json(regression, params, results);
+
+  if (!regression.report.empty()) {
+    std::ofstream file {regression.report};
+    file << json;
+    if (!file) {
+      fmt::println("could not write {}", regression.report);
+      return 1;
+    }
+  } else {
+    fmt::print("{}", json);
+  }
+
+  if (!regression.baseline.empty()) {
+    const auto base = read_baseline(regression.baseline);
+    if (!base) {
+      fmt::println("could not read baseline {}", regression.baseline);
+      return 1;
+    }
+    passed = compare(regression, *base, results) && passed;
+  }
+
+  return passed ? 0 : 1;
+}
+
+}    // namespace bench
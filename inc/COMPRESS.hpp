@@ -1,84 +1,560 @@
 #pragma once
 
+#include "DICTIONARY.hpp"
 #include "HUFFMAN.hpp"
+#include "MEMO.hpp"
+#include "ORDER1.hpp"
+#include "SHUFFLE.hpp"
 #include "SOCA.hpp"
+#include "STATS.hpp"
 #include "UTIL.hpp"
 #include "fmt/base.h"
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <optional>
 #include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 namespace impl::compress {
 
-template<size_t rule, typename ItrFreq, typename ItrData>
-uint8_t section(ItrFreq freqBegin,
-                ItrFreq freqEnd,
-                ItrData dataBegin,
-                ItrData dataEnd) {
-  ++(*freqBegin);
-  double best_entropy = util::calculate_entropy(freqBegin, freqEnd);
-  --(*freqBegin);
+// generations searched per section, the chosen count is stored in one byte
+constexpr uint8_t max_count = 32;
 
-  uint8_t best_count = 0;
+// count symbol of a run: a full section of a single byte, woven as the symbol
+// and that byte only and filled back on decompression without stepping
+constexpr uint8_t run_count = max_count + 1;
 
-  ++(*(freqBegin + 1));
+// SOCA needs a range of even size of at least 4, other sections stay as is
+constexpr bool transformable(ptrdiff_t size) {
+  return size >= 4 && size % 2 == 0;
+}
 
-  for (uint8_t count = 0; count < 32; ++count) {
-    for (auto itr = dataBegin; itr != dataEnd; ++itr) {
-      --(*(freqBegin + *itr));
+// generations below which stepping a section back beats jumping it, see
+// ::soca::jump_reverse. Fixed sections step packed and never jump.
+constexpr uint8_t min_jump = 4;
+
+// SOCA kernels for a rule known at compile time
+template<uint8_t rule>
+struct static_rule {
+  // step from generation - 1 to generation
+  template<typename Itr>
+  constexpr void forward(Itr begin, Itr end, uint8_t generation) const {
+    if (generation % 2 == 1) {
+      ::soca::forward_front<rule>(begin, end);
+    } else {
+      ::soca::forward_back<rule>(begin, end);
+    }
+  }
+
+  // step from generation to generation - 1
+  template<typename Itr>
+  constexpr void reverse(Itr begin, Itr end, uint8_t generation) const {
+    if (generation % 2 == 0) {
+      ::soca::reverse_back<rule>(begin, end);
+    } else {
+      ::soca::reverse_front<rule>(begin, end);
+    }
+  }
+
+  // steps back from generation at once, false if they must be stepped
+  template<typename Itr>
+  bool jump_reverse(Itr     begin,
+                    Itr     end,
+                    uint8_t generation,
+                    uint8_t steps) const {
+    if constexpr (::soca::additive(rule)) {
+      return steps >= min_jump &&
+             ::soca::jump_reverse(begin, end, rule, generation, steps);
+    }
+    return false;
+  }
+
+  // step of a fixed section between generation - 1 and generation, the
+  // same half changes going either way
+  template<size_t size>
+  constexpr void step(::soca::fixed_section<size>& state,
+                      uint8_t                      generation) const {
+    if (generation % 2 == 1) {
+      state.template forward_front<rule>();
+    } else {
+      state.template forward_back<rule>();
+    }
+  }
+};
+
+// SOCA kernels for a rule known at run time
+struct dynamic_rule {
+  uint8_t rule;
+
+  // step from generation - 1 to generation
+  template<typename Itr>
+  constexpr void forward(Itr begin, Itr end, uint8_t generation) const {
+    if (generation % 2 == 1) {
+      ::soca::forward_front(begin, end, rule);
+    } else {
+      ::soca::forward_back(begin, end, rule);
+    }
+  }
+
+  // step from generation to generation - 1
+  template<typename Itr>
+  constexpr void reverse(Itr begin, Itr end, uint8_t generation) const {
+    if (generation % 2 == 0) {
+      ::soca::reverse_back(begin, end, rule);
+    } else {
+      ::soca::reverse_front(begin, end, rule);
     }
-    --(*(freqBegin + count + 1));
+  }
+
+  // steps back from generation at once, false if they must be stepped
+  template<typename Itr>
+  bool jump_reverse(Itr     begin,
+                    Itr     end,
+                    uint8_t generation,
+                    uint8_t steps) const {
+    return steps >= min_jump &&
+           ::soca::jump_reverse(begin, end, rule, generation, steps);
+  }
 
-    if (count % 2 == 0) {
-      soca::forward_front<rule>(dataBegin, dataEnd);
+  // step of a fixed section between generation - 1 and generation, the
+  // same half changes going either way
+  template<size_t size>
+  constexpr void step(::soca::fixed_section<size>& state,
+                      uint8_t                      generation) const {
+    if (generation % 2 == 1) {
+      state.forward_front(rule);
     } else {
-      soca::forward_back<rule>(dataBegin, dataEnd);
+      state.forward_back(rule);
     }
+  }
+};
+
+// histogram entropy timed into the entropy stage of the statistics
+inline double timed_entropy(util::histogram& histogram) {
+  impl::stats::stage_timer timer {&::stats::counters::entropy};
+  return histogram.entropy();
+}
+
+/***
+ * @brief finds the SOCA count giving the lowest entropy of the whole stream
+ * @note IN-PLACE, the section is left transformed by the returned count
+ * histogram holds the stream, the section and its count symbol are accounted
+ * in it on return. Counts up to depth are tried, each generation costs
+ * penalty bits on top of the entropy, as decoding steps back through all of
+ * them.
+ ***/
+template<typename Rule, typename ItrData>
+uint8_t search_count(util::histogram& histogram,
+                     ItrData          dataBegin,
+                     ItrData          dataEnd,
+                     Rule             rule,
+                     uint8_t          depth   = max_count,
+                     double           penalty = 0.0) {
+  histogram.increment(0);
+
+  if (!transformable(std::distance(dataBegin, dataEnd))) {
+    return 0;
+  }
+
+  impl::stats::record(
+  [&](::stats::counters& stats) { stats.generations += depth; });
+
+  double best_entropy = timed_entropy(histogram);
+  histogram.decrement(0);
+
+  uint8_t best_count = 0;
+
+  for (uint8_t count = 1; count <= depth; ++count) {
+    for (auto itr = dataBegin; itr != dataEnd; ++itr) {
+      histogram.decrement(*itr);
+    }
+
+    rule.forward(dataBegin, dataEnd, count);
 
     for (auto itr = dataBegin; itr != dataEnd; ++itr) {
-      ++(*(freqBegin + *itr));
+      histogram.increment(*itr);
     }
-    ++(*(freqBegin + count + 1));
+    histogram.increment(count);
 
-    const double entropy = util::calculate_entropy(freqBegin, freqEnd);
+    const double entropy = timed_entropy(histogram) + penalty * count;
     if (entropy < best_entropy) {
       best_entropy = entropy;
-      best_count   = count + 1;
+      best_count   = count;
     }
+
+    histogram.decrement(count);
   }
 
   for (auto itr = dataBegin; itr != dataEnd; ++itr) {
-    --(*(freqBegin + *itr));
+    histogram.decrement(*itr);
   }
-  --(*(freqBegin + 32));
 
-  for (uint8_t count = 32; count > best_count; --count) {
-    if (count % 2 == 0) {
-      soca::reverse_back<rule>(dataBegin, dataEnd);
-    } else {
-      soca::reverse_front<rule>(dataBegin, dataEnd);
+  if (!rule.jump_reverse(dataBegin, dataEnd, depth, depth - best_count)) {
+    for (uint8_t count = depth; count > best_count; --count) {
+      rule.reverse(dataBegin, dataEnd, count);
     }
   }
 
   for (auto itr = dataBegin; itr != dataEnd; ++itr) {
-    ++(*(freqBegin + *itr));
+    histogram.increment(*itr);
   }
-  ++(*(freqBegin + best_count));
+  histogram.increment(best_count);
 
   return best_count;
 }
 
-template<size_t rule, typename Itr>
-void section_decompress(Itr begin, Itr end, uint8_t count) {
-  for (uint8_t i = count; i > 0; --i) {
-    if (count % 2 == 0) {
-      soca::reverse_back<rule>(begin, end);
+template<uint8_t rule, typename ItrData>
+uint8_t section(util::histogram& histogram,
+                ItrData          dataBegin,
+                ItrData          dataEnd,
+                uint8_t          depth   = max_count,
+                double           penalty = 0.0) {
+  return search_count(histogram,
+                      dataBegin,
+                      dataEnd,
+                      static_rule<rule> {},
+                      depth,
+                      penalty);
+}
+
+template<typename ItrData>
+uint8_t section(util::histogram& histogram,
+                ItrData          dataBegin,
+                ItrData          dataEnd,
+                uint8_t          rule,
+                uint8_t          depth   = max_count,
+                double           penalty = 0.0) {
+  return search_count(histogram,
+                      dataBegin,
+                      dataEnd,
+                      dynamic_rule {.rule = rule},
+                      depth,
+                      penalty);
+}
+
+/***
+ * @brief search_count for a full section of compile time size
+ * @note the section stays packed in registers for all generations, only the
+ * half changed by a step is re-histogrammed, as one fused replace per byte,
+ * and the best generation is kept as a copy instead of being reached again
+ * by reverse steps
+ ***/
+template<size_t section_size, typename Rule, typename ItrData>
+requires(transformable(section_size))
+uint8_t search_fixed(util::histogram& histogram,
+                     ItrData          dataBegin,
+                     Rule             rule,
+                     uint8_t          depth   = max_count,
+                     double           penalty = 0.0) {
+  using state_type = ::soca::fixed_section<section_size>;
+
+  state_type state {dataBegin};
+
+  impl::stats::record(
+  [&](::stats::counters& stats) { stats.generations += depth; });
+
+  histogram.increment(0);
+  double best_entropy = timed_entropy(histogram);
+  histogram.decrement(0);
+
+  state_type best_state = state;
+  uint8_t    best_count = 0;
+
+  std::array<uint8_t, state_type::half_size> before;
+
+  for (uint8_t count = 1; count <= depth; ++count) {
+    if (count % 2 == 1) {
+      for (size_t idx = 0; idx < state_type::half_size; ++idx) {
+        before[idx] = state.front_byte(idx);
+      }
+      rule.step(state, count);
+      for (size_t idx = 0; idx < state_type::half_size; ++idx) {
+        histogram.replace(before[idx], state.front_byte(idx));
+      }
     } else {
-      soca::reverse_front<rule>(begin, end);
+      for (size_t idx = 0; idx < state_type::half_size; ++idx) {
+        before[idx] = state.back_byte(idx);
+      }
+      rule.step(state, count);
+      for (size_t idx = 0; idx < state_type::half_size; ++idx) {
+        histogram.replace(before[idx], state.back_byte(idx));
+      }
     }
+    histogram.increment(count);
+
+    const double entropy = timed_entropy(histogram) + penalty * count;
+    if (entropy < best_entropy) {
+      best_entropy = entropy;
+      best_count   = count;
+      best_state   = state;
+    }
+
+    histogram.decrement(count);
+  }
+
+  for (size_t idx = 0; idx < state_type::half_size; ++idx) {
+    histogram.replace(state.front_byte(idx), best_state.front_byte(idx));
+    histogram.replace(state.back_byte(idx), best_state.back_byte(idx));
+  }
+  histogram.increment(best_count);
+
+  best_state.store(dataBegin);
+
+  return best_count;
+}
+
+template<uint8_t rule, size_t section_size, typename ItrData>
+requires(transformable(section_size))
+uint8_t section(util::histogram& histogram,
+                ItrData          dataBegin,
+                uint8_t          depth   = max_count,
+                double           penalty = 0.0) {
+  return search_fixed<section_size>(histogram,
+                                    dataBegin,
+                                    static_rule<rule> {},
+                                    depth,
+                                    penalty);
+}
+
+template<typename Rule, typename Itr>
+void reverse_count(Itr begin, Itr end, uint8_t count, Rule rule) {
+  if (!transformable(std::distance(begin, end)) ||
+      rule.jump_reverse(begin, end, count, count)) {
+    return;
+  }
+
+  for (uint8_t generation = count; generation > 0; --generation) {
+    rule.reverse(begin, end, generation);
   }
 }
 
-template<size_t period, typename ItrBase, typename ItrWeave>
+template<uint8_t rule, typename Itr>
+void section_decompress(Itr begin, Itr end, uint8_t count) {
+  reverse_count(begin, end, count, static_rule<rule> {});
+}
+
+template<typename Itr>
+void section_decompress(Itr begin, Itr end, uint8_t count, uint8_t rule) {
+  reverse_count(begin, end, count, dynamic_rule {.rule = rule});
+}
+
+// reverse_count for a full section of compile time size
+template<size_t section_size, typename Rule, typename Itr>
+requires(transformable(section_size))
+void reverse_fixed(Itr begin, uint8_t count, Rule rule) {
+  ::soca::fixed_section<section_size> state {begin};
+
+  for (uint8_t generation = count; generation > 0; --generation) {
+    rule.step(state, generation);
+  }
+
+  state.store(begin);
+}
+
+template<uint8_t rule, size_t section_size, typename Itr>
+requires(transformable(section_size))
+void section_decompress(Itr begin, uint8_t count) {
+  reverse_fixed<section_size>(begin, count, static_rule<rule> {});
+}
+
+// sections are searched on a working copy, kernels see these types only
+using data_itr = std::vector<uint8_t>::iterator;
+
+// rule leaves a section of bytes all equal to byte as is in every
+// generation: no neighbourhood of its cells is in the rule, so both halves
+// are xored with 0
+constexpr bool uniform_fixed_point(uint8_t rule, uint8_t byte) {
+  uint8_t patterns = 0;
+  for (int bit = 0; bit < 8; ++bit) {
+    const int left   = byte >> (bit + 1) % 8 & 1;
+    const int center = byte >> bit & 1;
+    const int right  = byte >> (bit + 7) % 8 & 1;
+    patterns         |= 1 << (left << 2 | center << 1 | right);
+  }
+  return (rule & patterns) == 0;
+}
+
+// section of a single byte, compares 8 bytes per step and stops at the first
+// that differ
+inline bool uniform(data_itr begin, data_itr end) {
+  const auto     size    = static_cast<size_t>(std::distance(begin, end));
+  const uint8_t* data    = &*begin;
+  const uint64_t pattern = *begin * uint64_t {0x0101010101010101};
+
+  size_t idx = 0;
+  for (; idx + 8 <= size; idx += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + idx, 8);
+    if (word != pattern) {
+      return false;
+    }
+  }
+  for (; idx < size; ++idx) {
+    if (data[idx] != *begin) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// uniform section at a fixed point of rule, every count leaves it as is
+inline bool fixed_uniform(uint8_t rule, data_itr begin, data_itr end) {
+  return transformable(std::distance(begin, end)) &&
+         uniform_fixed_point(rule, *begin) && uniform(begin, end);
+}
+
+/***
+ * @brief search_count of a fixed_uniform section without stepping it
+ * @note the section is the same at every count, only the count symbol
+ * changes the entropy: the search keeps the first count of the largest
+ * histogram bin, as search_count and search_fixed would
+ ***/
+inline uint8_t search_uniform(util::histogram& histogram, uint8_t depth) {
+  uint8_t best_count = 0;
+  for (uint8_t count = 1; count <= depth; ++count) {
+    if (histogram[count] > histogram[best_count]) {
+      best_count = count;
+    }
+  }
+  histogram.increment(best_count);
+  return best_count;
+}
+
+// per section search and reverse, rule and section size fixed at compile time
+template<uint8_t rule, size_t section_size>
+struct static_kernels {
+  static uint8_t search(util::histogram& histogram,
+                        data_itr         dataBegin,
+                        data_itr         dataEnd,
+                        uint8_t          depth,
+                        double           penalty) {
+    if constexpr (transformable(section_size)) {
+      if (std::distance(dataBegin, dataEnd) == section_size) {
+        return section<rule, section_size>(
+        histogram, dataBegin, depth, penalty);
+      }
+    }
+    return section<rule>(histogram, dataBegin, dataEnd, depth, penalty);
+  }
+
+  static void reverse(data_itr begin, data_itr end, uint8_t count) {
+    if constexpr (transformable(section_size)) {
+      if (std::distance(begin, end) == section_size) {
+        section_decompress<rule, section_size>(begin, count);
+        return;
+      }
+    }
+    section_decompress<rule>(begin, end, count);
+  }
+};
+
+// per section search and reverse, rule known at run time
+struct dynamic_kernels {
+  uint8_t rule;
+
+  uint8_t search(util::histogram& histogram,
+                 data_itr         dataBegin,
+                 data_itr         dataEnd,
+                 uint8_t          depth,
+                 double           penalty) const {
+    return section(histogram, dataBegin, dataEnd, rule, depth, penalty);
+  }
+
+  void reverse(data_itr begin, data_itr end, uint8_t count) const {
+    section_decompress(begin, end, count, rule);
+  }
+};
+
+template<uint8_t rule, size_t section_size>
+void fixed_step(::soca::fixed_section<section_size>& state,
+                uint8_t                                generation) {
+  static_rule<rule> {}.step(state, generation);
+}
+
+// fixed section step of a rule picked at run time
+template<size_t section_size>
+struct pointer_rule {
+  void (*fixed_step)(::soca::fixed_section<section_size>&, uint8_t);
+
+  void step(::soca::fixed_section<section_size>& state,
+            uint8_t                              generation) const {
+    fixed_step(state, generation);
+  }
+};
+
+/***
+ * @brief per section search and reverse behind the runtime dispatch table
+ * @note only the step is specialized on the rule, the search over a section
+ * size is shared by all rules, which keeps the table cheap to compile. Short
+ * tail sections take the runtime rule kernels.
+ ***/
+template<uint8_t rule, size_t section_size>
+struct dispatch_kernels {
+  static uint8_t search(util::histogram& histogram,
+                        data_itr         dataBegin,
+                        data_itr         dataEnd,
+                        uint8_t          depth,
+                        double           penalty) {
+    if constexpr (transformable(section_size)) {
+      if (std::distance(dataBegin, dataEnd) == section_size) {
+        return search_fixed<section_size>(
+        histogram,
+        dataBegin,
+        pointer_rule<section_size> {&fixed_step<rule, section_size>},
+        depth,
+        penalty);
+      }
+    }
+    return section(histogram, dataBegin, dataEnd, rule, depth, penalty);
+  }
+
+  static void reverse(data_itr begin, data_itr end, uint8_t count) {
+    if constexpr (transformable(section_size)) {
+      if (std::distance(begin, end) == section_size) {
+        reverse_fixed<section_size>(
+        begin,
+        count,
+        pointer_rule<section_size> {&fixed_step<rule, section_size>});
+        return;
+      }
+    }
+    section_decompress(begin, end, count, rule);
+  }
+};
+
+// type erased dispatch_kernels, entry of the runtime dispatch table
+struct section_kernels {
+  uint8_t (*search)(util::histogram&, data_itr, data_itr, uint8_t, double);
+  void (*reverse)(data_itr, data_itr, uint8_t);
+  uint8_t rule;
+};
+
+// rule the kernels step with
+template<uint8_t rule, size_t section_size>
+constexpr uint8_t rule_of(static_kernels<rule, section_size> /*unused*/) {
+  return rule;
+}
+
+inline uint8_t rule_of(const dynamic_kernels& kernels) {
+  return kernels.rule;
+}
+
+inline uint8_t rule_of(const section_kernels& kernels) {
+  return kernels.rule;
+}
+
+// Woven layout: every period-th element (starting at 0) comes from weave,
+// the rest from base, i.e. a soca count followed by its section.
+template<typename ItrBase, typename ItrWeave>
 requires std::random_access_iterator<ItrBase> &&
          std::random_access_iterator<ItrWeave>
 class weaving_iterator {
@@ -93,15 +569,27 @@ private:
   ItrBase         base;
   ItrWeave        weave;
   difference_type count;
+  difference_type period;
+  difference_type phase;
 
 public:
-  constexpr weaving_iterator(): base(), weave(), count(0) {
+  constexpr weaving_iterator():
+    base(),
+    weave(),
+    count(0),
+    period(1),
+    phase(0) {
   }
 
-  constexpr weaving_iterator(ItrBase base, ItrWeave weave, ptrdiff_t count = 0):
+  constexpr weaving_iterator(ItrBase         base,
+                             ItrWeave        weave,
+                             difference_type period,
+                             difference_type count = 0):
     base(base),
     weave(weave),
-    count(count) {
+    count(count),
+    period(period),
+    phase(count % period) {
   }
 
   constexpr std::strong_ordering operator<=>(
@@ -118,16 +606,19 @@ public:
   }
 
   constexpr value_type operator*() const {
-    return count % period == 0 ? *weave : *base;
+    return phase == 0 ? *weave : *base;
   }
 
   constexpr weaving_iterator& operator++() {
-    if (count % period == 0) {
+    if (phase == 0) {
       ++weave;
     } else {
       ++base;
     }
     ++count;
+    if (++phase == period) {
+      phase = 0;
+    }
     return *this;
   }
 
@@ -138,136 +629,833 @@ public:
   }
 };
 
-template<size_t period, typename ItrBase, typename ItrWeave>
-constexpr weaving_iterator<period, ItrBase, ItrWeave>
-weaving_begin(ItrBase base_begin, ItrBase base_end, ItrWeave weave_begin) {
-  return weaving_iterator<period, ItrBase, ItrWeave>(base_begin,
-                                                     weave_begin,
-                                                     0);
+template<typename ItrBase, typename ItrWeave>
+constexpr weaving_iterator<ItrBase, ItrWeave> weaving_begin(
+ItrBase   base_begin,
+ItrBase   base_end,
+ItrWeave  weave_begin,
+ptrdiff_t period) {
+  return weaving_iterator<ItrBase, ItrWeave>(base_begin,
+                                             weave_begin,
+                                             period,
+                                             0);
 }
 
-template<size_t period, typename ItrBase, typename ItrWeave>
-constexpr weaving_iterator<period, ItrBase, ItrWeave>
-weaving_end(ItrBase base_begin, ItrBase base_end, ItrWeave weave_begin) {
-  const auto base_size = std::distance(base_begin, base_end);
+template<typename ItrBase, typename ItrWeave>
+constexpr weaving_iterator<ItrBase, ItrWeave> weaving_end(
+ItrBase   base_begin,
+ItrBase   base_end,
+ItrWeave  weave_begin,
+ptrdiff_t period) {
+  const auto base_size  = std::distance(base_begin, base_end);
+  const auto weave_size = (base_size + period - 2) / (period - 1);
 
-  return weaving_iterator<period, ItrBase, ItrWeave>(
-  base_end,
-  weave_begin + (base_size / period + 1),
-  base_size + base_size / period + 1);
+  return weaving_iterator<ItrBase, ItrWeave>(base_end,
+                                             weave_begin + weave_size,
+                                             period,
+                                             base_size + weave_size);
 }
 
-template<size_t period, typename ItrBase, typename ItrWeave>
-class deweaving_iterator {
-public:
-  using iterator_category = std::output_iterator_tag;
-  using value_type        = uint8_t;
-  using difference_type   = ptrdiff_t;
-  using pointer           = value_type*;
-  using reference         = value_type&;
+}    // namespace impl::compress
 
-private:
-  ItrBase   base;
-  ItrWeave  weave;
-  difference_type count {0};
+// entropy coder of the woven sections, decoding must use the encoding one
+enum class entropy_model : uint8_t {
+  order0     = 0,    // huffman::encode, one table
+  order1     = 1,    // order1::encode, a table per cluster of previous bytes
+  dictionary = 2,    // dictionary::encode, a pretrained table
+};
 
-public:
-  constexpr deweaving_iterator(ItrBase base, ItrWeave weave):
-    base(base),
-    weave(weave) {
+/***
+ * @brief scratch memory and settings of compress(), reused by every call
+ * @note buffers grow to the largest input seen and are kept, calls in steady
+ * state do not allocate. A context must not be used by two calls at once.
+ ***/
+struct compression_context {
+  std::vector<uint8_t>    data;    // working copy, searched in place
+  std::vector<uint8_t>    soca_counts;
+  huffman::encode_context entropy;
+  order1::encode_context  order1_entropy;
+
+  // scratch of parse::compress: the woven sections, and per position of the
+  // parse the estimated bits to the end and the section size taken
+  std::vector<uint8_t> woven;
+  std::vector<double>  parse_costs;
+  std::vector<uint8_t> parse_sizes;
+
+  entropy_model            model      = entropy_model::order0;
+  const dictionary::table* dictionary = nullptr;    // of model dictionary
+
+  // searches of repeated sections taken from here when set, the cache
+  // outlives calls and is shared by every call using the context
+  memo::cache* memo = nullptr;
+
+  // decode speed against size: bits a generation must save to be chosen,
+  // and the generations decompression steps through per call at most
+  double generation_penalty = 0.0;
+  size_t generation_budget  = std::numeric_limits<size_t>::max();
+
+  // huffman::encode_parallel workers, 0 for all cores, 1 encodes serially,
+  // order1 always encodes serially
+  size_t entropy_threads = 1;
+
+  // full uniform sections woven as run_count and their byte, off keeps the
+  // woven layout of decoders without runs
+  bool run_tokens = true;
+
+  // shuffle of the input ahead of the search, see SHUFFLE.hpp, into scratch
+  // shuffled. Decompression must use the same mode and width.
+  ::shuffle::mode      shuffle       = ::shuffle::mode::none;
+  size_t               element_width = 1;
+  std::vector<uint8_t> shuffled;
+
+  // byte histogram of the next input, set by a caller that counted it
+  // already, as the stream does for its stored block check. The next
+  // compress() starts its search from it instead of counting, and resets it.
+  std::optional<util::histogram> input_histogram;
+};
+
+// scratch memory of decompress(), see compression_context, model must be the
+// one of the compression
+struct decompression_context {
+  std::vector<uint8_t>    woven;
+  std::vector<uint8_t>    sections;
+  std::vector<uint8_t>    soca_counts;
+  huffman::decode_context entropy;
+  order1::decode_context  order1_entropy;
+
+  entropy_model               model        = entropy_model::order0;
+  const dictionary::registry* dictionaries = nullptr;    // of model dictionary
+
+  // of the compression, sections are unshuffled into shuffled
+  ::shuffle::mode      shuffle       = ::shuffle::mode::none;
+  size_t               element_width = 1;
+  std::vector<uint8_t> shuffled;
+};
+
+namespace impl::compress {
+
+/***
+ * @brief SOCA count of one section, left transformed by it, see
+ * search_sections
+ * @note budget is what is left of context.generation_budget, the count is
+ * taken from it
+ ***/
+template<typename Kernels>
+uint8_t search_section(util::histogram&     histogram,
+                       data_itr             section_begin,
+                       data_itr             section_end,
+                       Kernels              kernels,
+                       uint8_t              depth,
+                       compression_context& context,
+                       size_t&              budget) {
+  const uint8_t rule    = rule_of(kernels);
+  const double  penalty = context.generation_penalty;
+
+  const auto section_depth =
+  static_cast<uint8_t>(std::min<size_t>(depth, budget));
+  const auto search = [&] {
+    return kernels.search(
+    histogram, section_begin, section_end, section_depth, penalty);
+  };
+
+  if (fixed_uniform(rule, section_begin, section_end)) {
+    impl::stats::record(
+    [](::stats::counters& stats) { ++stats.uniform_sections; });
+    return search_uniform(histogram, depth);
   }
 
-  constexpr bool operator==(const deweaving_iterator& other) const {
-    return count == other.count;
+  if (context.memo == nullptr) {
+    const uint8_t count  = search();
+    budget              -= count;
+    return count;
   }
 
-  constexpr bool operator!=(const deweaving_iterator& other) const {
-    return !(*this == other);
+  // a memo hit moves the section from its original to its remembered bytes
+  // in the histogram, as the search would have. Penalties differing in the
+  // low 16 bits of their mantissa only share results.
+  const uint64_t penalty_key = std::bit_cast<uint64_t>(penalty) >> 16 << 16;
+  const uint64_t settings =
+  penalty_key ^ (rule | uint64_t {section_depth} << 8);
+
+  const uint8_t count = context.memo->search(
+  settings,
+  {section_begin, section_end},
+  search,
+  [&](std::span<const uint8_t> result, uint8_t count) {
+    histogram.replace(section_begin, section_end, result.begin());
+    histogram.increment(count);
+  });
+  budget -= count;
+  return count;
+}
+
+// context.data shuffled in place by the shuffle of the context, if any
+inline void shuffle_data(compression_context& context) {
+  if (context.shuffle == ::shuffle::mode::none) {
+    return;
   }
+  context.shuffled.resize(context.data.size());
+  ::shuffle::apply(
+  context.shuffle, context.data, context.shuffled, context.element_width);
+  context.data.swap(context.shuffled);
+}
 
-  constexpr deweaving_iterator& operator*() {
-    return *this;
+// histogram of context.data, context.input_histogram if set, which is reset.
+// A shuffle only reorders the bytes, the histogram holds for both orders.
+inline util::histogram input_histogram_of(compression_context& context) {
+  util::histogram histogram;
+  if (context.input_histogram) {
+    histogram = *context.input_histogram;
+    context.input_histogram.reset();
+  } else {
+    histogram.add(context.data.begin(), context.data.end());
   }
+  return histogram;
+}
 
-  constexpr deweaving_iterator& operator++() {
-    return *this;
+/***
+ * @brief SOCA search of every section of [begin, end) into context.data and
+ * context.soca_counts
+ * @note sections take their counts greedily from context.generation_budget,
+ * once it is spent the rest stay as is. Runs and fixed_uniform sections are
+ * not stepped by decompression and take nothing from it.
+ * @return histogram of the input, counted or context.input_histogram, which
+ * the searches keep
+ ***/
+template<typename Kernels, typename ItrIn>
+util::histogram search_sections(ItrIn                begin,
+                                ItrIn                end,
+                                size_t               section_size,
+                                Kernels              kernels,
+                                uint8_t              depth,
+                                compression_context& context) {
+  auto& data = context.data;
+  data.assign(begin, end);
+  const auto size = std::ssize(data);
+
+  shuffle_data(context);
+  util::histogram histogram = input_histogram_of(context);
+
+  const auto step = static_cast<ptrdiff_t>(section_size);
+
+  auto& soca_counts = context.soca_counts;
+  soca_counts.clear();
+  soca_counts.reserve(size / step + 1);
+
+  size_t budget = context.generation_budget;
+
+  // a run is woven as two bytes, shorter sections gain nothing from it
+  const bool runs = context.run_tokens && step > 2;
+
+  for (ptrdiff_t start = 0; start < size; start += step) {
+    impl::stats::stage_timer timer {&::stats::counters::search};
+
+    const auto section_begin = data.begin() + start;
+    const auto section_end   = data.begin() + std::min(start + step, size);
+    if (runs && section_end - section_begin == step &&
+        uniform(section_begin, section_end)) {
+      histogram.decrement(*section_begin, section_size - 1);
+      histogram.increment(run_count);
+      soca_counts.push_back(run_count);
+      continue;
+    }
+    soca_counts.emplace_back(search_section(
+    histogram, section_begin, section_end, kernels, depth, context, budget));
   }
 
-  constexpr deweaving_iterator& operator++(int) {
-    return *this;
+  impl::stats::record([&](::stats::counters& stats) {
+    stats.compress_bytes_in += size;
+    stats.sections          += soca_counts.size();
+    for (const uint8_t count : soca_counts) {
+      ++stats.chosen_counts[count];
+    }
+  });
+
+  return histogram;
+}
+
+/***
+ * @brief fn(begin, end) over the woven bytes of the sections search_sections
+ * left in context
+ * @note without runs the sections are woven on the fly, runs are woven into
+ * context.woven first
+ ***/
+template<typename Fn>
+void with_woven(size_t section_size, compression_context& context, Fn fn) {
+  const auto& data        = context.data;
+  const auto& soca_counts = context.soca_counts;
+  const auto  step        = static_cast<ptrdiff_t>(section_size);
+
+  if (std::find(soca_counts.begin(), soca_counts.end(), run_count) ==
+      soca_counts.end()) {
+    fn(weaving_begin(data.begin(), data.end(), soca_counts.begin(), step + 1),
+       weaving_end(data.begin(), data.end(), soca_counts.begin(), step + 1));
+    return;
   }
 
-  constexpr deweaving_iterator& operator=(value_type value) {
-    if (count % period == 0) {
-      *weave++ = value;
+  auto& woven = context.woven;
+  woven.clear();
+  woven.reserve(data.size() + soca_counts.size());
+
+  const auto size = std::ssize(data);
+  ptrdiff_t  start = 0;
+  for (const uint8_t count : soca_counts) {
+    woven.push_back(count);
+    if (count == run_count) {
+      woven.push_back(data[start]);
     } else {
-      *base++ = value;
+      woven.insert(woven.end(),
+                   data.begin() + start,
+                   data.begin() + std::min(start + step, size));
     }
-    ++count;
-    return *this;
+    start += step;
   }
-};
+  fn(woven.cbegin(), woven.cend());
+}
 
-template<size_t period, typename ItrBase, typename ItrWeave>
-constexpr deweaving_iterator<period, ItrBase, ItrWeave> deweaving_begin(
-ItrBase  base,
-ItrWeave weave) {
-  return deweaving_iterator<period, ItrBase, ItrWeave>(base, weave);
+// woven sections through the entropy coder of context.model, histogram
+// counts the woven bytes
+template<typename ItrWoven, typename ItrOut>
+void encode_woven(ItrWoven               begin,
+                  ItrWoven               end,
+                  ItrOut                 out,
+                  const util::histogram& histogram,
+                  compression_context&   context) {
+  if (context.model == entropy_model::order1) {
+    ::order1::encode(begin, end, out, context.order1_entropy);
+  } else if (context.model == entropy_model::dictionary) {
+    ::dictionary::encode(begin, end, out, *context.dictionary);
+  } else if (context.entropy_threads == 1) {
+    ::huffman::encode(begin, end, out, context.entropy, histogram.bins());
+  } else {
+    ::huffman::encode_parallel(begin,
+                               end,
+                               out,
+                               context.entropy,
+                               histogram.bins(),
+                               context.entropy_threads);
+  }
+}
+
+template<typename Kernels, typename ItrIn, typename ItrOut>
+void encode_sections(ItrIn                begin,
+                     ItrIn                end,
+                     ItrOut               out,
+                     size_t               section_size,
+                     Kernels              kernels,
+                     uint8_t              depth,
+                     compression_context& context) {
+  if (begin == end) {
+    context.input_histogram.reset();
+    return;
+  }
+  if (context.model == entropy_model::dictionary &&
+      context.dictionary == nullptr) {
+    throw std::invalid_argument("dictionary model without a table");
+  }
+
+  const auto histogram =
+  search_sections(begin, end, section_size, kernels, depth, context);
+
+  with_woven(section_size, context, [&](auto woven_begin, auto woven_end) {
+    encode_woven(woven_begin, woven_end, out, histogram, context);
+  });
+}
+
+// @throws std::invalid_argument if the context has no dictionaries
+inline const ::dictionary::registry& dictionaries_of(
+const decompression_context& context) {
+  if (context.dictionaries == nullptr) {
+    throw std::invalid_argument("dictionary model without dictionaries");
+  }
+  return *context.dictionaries;
+}
+
+// encode_woven reversed, decoding stops after limit woven bytes
+template<typename ItrIn, typename ItrWoven>
+void decode_woven(ItrIn                  begin,
+                  ItrIn                  end,
+                  ItrWoven               woven,
+                  decompression_context& context,
+                  size_t                 limit) {
+  if (context.model == entropy_model::order1) {
+    ::order1::decode(begin, end, woven, context.order1_entropy, limit);
+  } else if (context.model == entropy_model::dictionary) {
+    ::dictionary::decode(begin, end, woven, dictionaries_of(context), limit);
+  } else {
+    ::huffman::decode(begin, end, woven, context.entropy, limit);
+  }
+}
+
+/***
+ * @brief context.woven split into context.sections and context.soca_counts,
+ * runs filled to a full section
+ * @note a run cut by a partial decode ends the sections before it
+ * @throws std::runtime_error on a run without its byte, unless partial
+ ***/
+inline void unweave(size_t                 section_size,
+                    decompression_context& context,
+                    bool                   partial) {
+  const auto& woven       = context.woven;
+  auto&       sections    = context.sections;
+  auto&       soca_counts = context.soca_counts;
+  soca_counts.clear();
+  sections.clear();
+  sections.reserve(woven.size());
+
+  for (size_t idx = 0; idx < woven.size();) {
+    const uint8_t count = woven[idx++];
+    if (count == run_count) {
+      if (idx == woven.size()) {
+        if (partial) {
+          return;
+        }
+        throw std::runtime_error("truncated run");
+      }
+      soca_counts.push_back(count);
+      sections.insert(sections.end(), section_size, woven[idx++]);
+      continue;
+    }
+    const size_t length = std::min(section_size, woven.size() - idx);
+    soca_counts.push_back(count);
+    sections.insert(sections.end(),
+                    woven.begin() + static_cast<ptrdiff_t>(idx),
+                    woven.begin() + static_cast<ptrdiff_t>(idx + length));
+    idx += length;
+  }
+}
+
+// context.sections in input order, unshuffled into context.shuffled
+inline const std::vector<uint8_t>& unshuffled(decompression_context& context) {
+  if (context.shuffle == ::shuffle::mode::none) {
+    return context.sections;
+  }
+  context.shuffled.resize(context.sections.size());
+  ::shuffle::revert(
+  context.shuffle, context.sections, context.shuffled, context.element_width);
+  return context.shuffled;
+}
+
+template<typename Kernels, typename ItrIn, typename ItrOut>
+void decode_sections(ItrIn                  begin,
+                     ItrIn                  end,
+                     ItrOut                 out,
+                     size_t                 section_size,
+                     Kernels                kernels,
+                     decompression_context& context) {
+  if (begin == end) {
+    return;
+  }
+
+  context.woven.clear();
+  decode_woven(begin,
+               end,
+               std::back_inserter(context.woven),
+               context,
+               std::numeric_limits<size_t>::max());
+  unweave(section_size, context, false);
+
+  const auto& soca_counts = context.soca_counts;
+  auto&       sections    = context.sections;
+
+  const auto step = static_cast<ptrdiff_t>(section_size);
+  const auto size = std::ssize(sections);
+
+  impl::stats::record([&](::stats::counters& stats) {
+    stats.decompress_bytes_in  += std::distance(begin, end);
+    stats.decompress_bytes_out += size;
+  });
+
+  // runs and fixed_uniform sections are already what every reverse step
+  // yields
+  const uint8_t rule = rule_of(kernels);
+
+  ptrdiff_t section = 0;
+  for (ptrdiff_t start = 0; start < size; start += step) {
+    impl::stats::stage_timer timer {&::stats::counters::reverse};
+
+    const auto section_begin = sections.begin() + start;
+    const auto section_end   = sections.begin() + std::min(start + step, size);
+    const uint8_t count      = soca_counts[section];
+    if (count != 0 && count != run_count &&
+        !fixed_uniform(rule, section_begin, section_end)) {
+      kernels.reverse(section_begin, section_end, count);
+    }
+    ++section;
+  }
+
+  const auto& result = unshuffled(context);
+  std::copy(result.begin(), result.end(), out);
+}
+
+/***
+ * @brief decode_sections of the bytes [offset, offset + length) only
+ * @note huffman decoding stops after the last section overlapping the range
+ * and only the sections overlapping it are reversed. A shuffle spreads the
+ * range over every section, shuffled input is decoded whole.
+ * @throws std::out_of_range if the range ends past the decoded bytes
+ ***/
+template<typename Kernels, typename ItrIn, typename ItrOut>
+void decode_sections_range(ItrIn                  begin,
+                           ItrIn                  end,
+                           ItrOut                 out,
+                           size_t                 section_size,
+                           Kernels                kernels,
+                           decompression_context& context,
+                           size_t                 offset,
+                           size_t                 length) {
+  if (length == 0) {
+    return;
+  }
+  if (length > std::numeric_limits<size_t>::max() - offset) {
+    throw std::out_of_range("range exceeds the decompressed size");
+  }
+
+  const bool   whole         = context.shuffle != ::shuffle::mode::none;
+  const size_t range_end     = offset + length;
+  const size_t first_section = whole ? 0 : offset / section_size;
+  const size_t last_section  = whole ? std::numeric_limits<size_t>::max() - 1
+                                     : (range_end - 1) / section_size;
+
+  // runs weave shorter than their sections, the limit is an upper bound
+  context.woven.clear();
+  if (begin != end) {
+    decode_woven(begin,
+                 end,
+                 std::back_inserter(context.woven),
+                 context,
+                 whole ? std::numeric_limits<size_t>::max()
+                       : (last_section + 1) * (section_size + 1));
+  }
+  unweave(section_size, context, !whole);
+
+  const auto& soca_counts = context.soca_counts;
+  auto&       sections    = context.sections;
+
+  const size_t size = sections.size();
+  if (size < range_end) {
+    throw std::out_of_range("range exceeds the decompressed size");
+  }
+
+  impl::stats::record([&](::stats::counters& stats) {
+    stats.decompress_bytes_in  += std::distance(begin, end);
+    stats.decompress_bytes_out += length;
+  });
+
+  const uint8_t rule = rule_of(kernels);
+
+  const size_t sections_end = std::min(last_section + 1, soca_counts.size());
+  for (size_t section = first_section; section < sections_end; ++section) {
+    impl::stats::stage_timer timer {&::stats::counters::reverse};
+    const size_t             start = section * section_size;
+
+    const auto section_begin = sections.begin() + start;
+    const auto section_end =
+    sections.begin() + std::min(start + section_size, size);
+    const uint8_t count = soca_counts[section];
+    if (count != 0 && count != run_count &&
+        !fixed_uniform(rule, section_begin, section_end)) {
+      kernels.reverse(section_begin, section_end, count);
+    }
+  }
+
+  const auto& result = unshuffled(context);
+  std::copy(result.begin() + offset, result.begin() + range_end, out);
 }
 
 }    // namespace impl::compress
 
 template<uint8_t rule, size_t section_size, typename ItrIn, typename ItrOut>
+requires(section_size > 0)
+void compress(ItrIn                begin,
+              ItrIn                end,
+              ItrOut               out,
+              compression_context& context) {
+  impl::compress::encode_sections(
+  begin,
+  end,
+  out,
+  section_size,
+  impl::compress::static_kernels<rule, section_size> {},
+  impl::compress::max_count,
+  context);
+}
+
+template<uint8_t rule, size_t section_size, typename ItrIn, typename ItrOut>
+requires(section_size > 0)
 void compress(ItrIn begin, ItrIn end, ItrOut out) {
-  auto size = std::distance(begin, end);
+  compression_context context;
+  compress<rule, section_size>(begin, end, out, context);
+}
+
+template<uint8_t rule, size_t section_size, typename ItrIn, typename ItrOut>
+requires(section_size > 0)
+void decompress(ItrIn                  begin,
+                ItrIn                  end,
+                ItrOut                 out,
+                decompression_context& context) {
+  impl::compress::decode_sections(
+  begin,
+  end,
+  out,
+  section_size,
+  impl::compress::static_kernels<rule, section_size> {},
+  context);
+}
+
+template<uint8_t rule, size_t section_size, typename ItrIn, typename ItrOut>
+requires(section_size > 0)
+void decompress(ItrIn begin, ItrIn end, ItrOut out) {
+  decompression_context context;
+  decompress<rule, section_size>(begin, end, out, context);
+}
+
+namespace impl::compress {
+
+// section sizes with specialized instantiations behind the runtime API
+inline constexpr std::array<size_t, 6> dispatch_section_sizes {
+  8, 16, 32, 40, 64, 128};
 
-  std::array<size_t, 256> freq {};
-  for (auto itr = begin; itr != end; ++itr) {
-    ++freq[*itr];
+constexpr std::optional<size_t> dispatch_index(uint8_t rule,
+                                               size_t  section_size) {
+  const auto found = std::find(dispatch_section_sizes.begin(),
+                               dispatch_section_sizes.end(),
+                               section_size);
+  if (found == dispatch_section_sizes.end()) {
+    return std::nullopt;
   }
 
-  std::vector<uint8_t> soca_counts;
+  return rule * dispatch_section_sizes.size() +
+         std::distance(dispatch_section_sizes.begin(), found);
+}
+
+template<size_t idx>
+using dispatch_entry =
+dispatch_kernels<static_cast<uint8_t>(idx / dispatch_section_sizes.size()),
+                 dispatch_section_sizes[idx % dispatch_section_sizes.size()]>;
+
+// table index is rule * dispatch_section_sizes.size() + section size index
+template<size_t... idx>
+constexpr std::array<section_kernels, sizeof...(idx)> make_dispatch_table(
+std::index_sequence<idx...> /*unused*/) {
+  return {section_kernels {
+  .search  = &dispatch_entry<idx>::search,
+  .reverse = &dispatch_entry<idx>::reverse,
+  .rule    = static_cast<uint8_t>(idx / dispatch_section_sizes.size())}...};
+}
+
+using dispatch_sequence =
+std::make_index_sequence<256 * dispatch_section_sizes.size()>;
+
+// variable template so the kernels are only instantiated when used
+template<typename Sequence = dispatch_sequence>
+constexpr auto dispatch_table = make_dispatch_table(Sequence {});
 
-  for (ptrdiff_t start = 0; start < size; start += section_size) {
-    soca_counts.emplace_back(
-    impl::compress::section<rule>(freq.begin(),
-                                  freq.end(),
-                                  begin + start,
-                                  begin + start +
-                                  std::min(static_cast<ptrdiff_t>(section_size),
-                                           std::distance(begin + start, end))));
+// fn(kernels) with the kernels the runtime API dispatches rule and section
+// size to
+template<typename Fn>
+void with_kernels(uint8_t rule, size_t section_size, Fn fn) {
+  if (const auto idx = dispatch_index(rule, section_size)) {
+    fn(dispatch_table<>[*idx]);
+    return;
   }
+  fn(dynamic_kernels {.rule = rule});
+}
 
-  huffman::encode(
-  impl::compress::weaving_begin<section_size>(begin, end, soca_counts.begin()),
-  impl::compress::weaving_end<section_size>(begin, end, soca_counts.begin()),
-  out);
+}    // namespace impl::compress
 
-  // todo: freq known here, optimize huffman?
-  // todo: data: 1 byte best soca, section_size bytes, ...
+/***
+ * @brief compress with rule and section size known only at run time
+ * @note section sizes in impl::compress::dispatch_section_sizes dispatch to
+ * kernels specialized on rule and section size, other sizes take the runtime
+ * rule kernels. depth bounds the searched SOCA counts.
+ * @throws std::invalid_argument for section_size of 0, depth above
+ * impl::compress::max_count or a context shuffle of element_width 0
+ ***/
+template<typename ItrIn, typename ItrOut>
+void compress(ItrIn                begin,
+              ItrIn                end,
+              ItrOut               out,
+              compression_context& context,
+              uint8_t              rule,
+              size_t               section_size,
+              uint8_t              depth = impl::compress::max_count) {
+  if (section_size == 0) {
+    throw std::invalid_argument("section_size must be positive");
+  }
+  if (depth > impl::compress::max_count) {
+    throw std::invalid_argument("depth must not exceed max_count");
+  }
+
+  if (const auto idx = impl::compress::dispatch_index(rule, section_size)) {
+    impl::compress::encode_sections(begin,
+                                    end,
+                                    out,
+                                    section_size,
+                                    impl::compress::dispatch_table<>[*idx],
+                                    depth,
+                                    context);
+    return;
+  }
+
+  impl::compress::encode_sections(
+  begin,
+  end,
+  out,
+  section_size,
+  impl::compress::dynamic_kernels {.rule = rule},
+  depth,
+  context);
 }
 
-template<uint8_t rule, size_t section_size, typename ItrIn, typename ItrOut>
-void decompress(ItrIn begin, ItrIn end, ItrOut out) {
-  std::vector<uint8_t> soca_counts;
-  std::vector<uint8_t> sections;
+template<typename ItrIn, typename ItrOut>
+void compress(ItrIn   begin,
+              ItrIn   end,
+              ItrOut  out,
+              uint8_t rule,
+              size_t  section_size,
+              uint8_t depth = impl::compress::max_count) {
+  compression_context context;
+  compress(begin, end, out, context, rule, section_size, depth);
+}
 
-  huffman::decode(begin,
-                  end,
-                  impl::compress::deweaving_begin<section_size>(
-                  std::back_inserter(sections),
-                  std::back_inserter(soca_counts)));
+/***
+ * @brief decompress with rule and section size known only at run time
+ * @note same dispatch as the runtime compress
+ * @throws std::invalid_argument for section_size of 0
+ ***/
+template<typename ItrIn, typename ItrOut>
+void decompress(ItrIn                  begin,
+                ItrIn                  end,
+                ItrOut                 out,
+                decompression_context& context,
+                uint8_t                rule,
+                size_t                 section_size) {
+  if (section_size == 0) {
+    throw std::invalid_argument("section_size must be positive");
+  }
 
-  ptrdiff_t section = 0;
-  for (size_t start = 0; start < sections.size(); start += section_size) {
-    impl::compress::section_decompress<rule>(
-    sections.begin() + start,
-    sections.begin() + start +
-    std::min(static_cast<ptrdiff_t>(section_size),
-             std::distance(sections.begin() + start, sections.end())),
-    soca_counts[section]);
-    ++section;
+  if (const auto idx = impl::compress::dispatch_index(rule, section_size)) {
+    impl::compress::decode_sections(begin,
+                                    end,
+                                    out,
+                                    section_size,
+                                    impl::compress::dispatch_table<>[*idx],
+                                    context);
+    return;
+  }
+
+  impl::compress::decode_sections(
+  begin,
+  end,
+  out,
+  section_size,
+  impl::compress::dynamic_kernels {.rule = rule},
+  context);
+}
+
+template<typename ItrIn, typename ItrOut>
+void decompress(ItrIn   begin,
+                ItrIn   end,
+                ItrOut  out,
+                uint8_t rule,
+                size_t  section_size) {
+  decompression_context context;
+  decompress(begin, end, out, context, rule, section_size);
+}
+
+/***
+ * @brief runtime decompress of the bytes [offset, offset + length) only
+ * @note the huffman stream is decoded up to the end of the range, only the
+ * sections overlapping the range are reversed. Shuffled input, see
+ * decompression_context::shuffle, is decoded whole.
+ * @throws std::invalid_argument for section_size of 0
+ * @throws std::out_of_range if the range ends past the decompressed size
+ ***/
+template<typename ItrIn, typename ItrOut>
+void decompress_range(ItrIn                  begin,
+                      ItrIn                  end,
+                      ItrOut                 out,
+                      decompression_context& context,
+                      uint8_t                rule,
+                      size_t                 section_size,
+                      size_t                 offset,
+                      size_t                 length) {
+  if (section_size == 0) {
+    throw std::invalid_argument("section_size must be positive");
+  }
+
+  if (const auto idx = impl::compress::dispatch_index(rule, section_size)) {
+    impl::compress::decode_sections_range(
+    begin,
+    end,
+    out,
+    section_size,
+    impl::compress::dispatch_table<>[*idx],
+    context,
+    offset,
+    length);
+    return;
+  }
+
+  impl::compress::decode_sections_range(
+  begin,
+  end,
+  out,
+  section_size,
+  impl::compress::dynamic_kernels {.rule = rule},
+  context,
+  offset,
+  length);
+}
+
+/***
+ * @brief compress with a pretrained dictionary table, at the rule, section
+ * size and depth it was trained for
+ * @note sets context.model and context.dictionary; the output names the
+ * table by its id and carries no huffman tree
+ ***/
+template<typename ItrIn, typename ItrOut>
+void compress(ItrIn                    begin,
+              ItrIn                    end,
+              ItrOut                   out,
+              compression_context&     context,
+              const dictionary::table& table) {
+  context.model      = entropy_model::dictionary;
+  context.dictionary = &table;
+  compress(begin,
+           end,
+           out,
+           context,
+           table.rule,
+           table.section_size,
+           table.depth);
+}
+
+/***
+ * @brief decompress output of the dictionary compress, with the table of the
+ * id the input names
+ * @note sets context.model and context.dictionaries
+ * @throws std::runtime_error if registry has no table of the id
+ ***/
+template<typename ItrIn, typename ItrOut>
+requires std::random_access_iterator<ItrIn>
+void decompress(ItrIn                       begin,
+                ItrIn                       end,
+                ItrOut                      out,
+                decompression_context&      context,
+                const dictionary::registry& registry) {
+  if (begin == end) {
+    return;
+  }
+
+  const dictionary::table* table =
+  registry.find(dictionary::table_id(begin, end));
+  if (table == nullptr) {
+    throw std::runtime_error("unknown dictionary table");
   }
 
-  std::copy(sections.begin(), sections.end(), out);
+  context.model        = entropy_model::dictionary;
+  context.dictionaries = &registry;
+  decompress(begin, end, out, context, table->rule, table->section_size);
 }
@@ -0,0 +1,284 @@
+#pragma once
+
+#include "ORDER1.hpp"
+#include "STATS.hpp"
+#include "UTIL.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// Pretrained code tables for small messages. A table is trained offline, see
+// tune::train, together with the rule, section size and depth it was trained
+// for, and shared by encoder and decoder ahead of time. Messages then carry
+// the id of their table instead of a huffman tree and skip building one.
+
+namespace dictionary {
+
+/***
+ * @brief canonical code of every byte with the compress() settings it was
+ * trained for
+ * @note build with make_table, which derives codes and decode_table
+ ***/
+struct table {
+  uint32_t                  id;
+  uint8_t                   rule;
+  size_t                    section_size;
+  uint8_t                   depth;
+  impl::order1::bit_lengths lengths;    // of every byte
+  std::array<uint16_t, 256> codes;
+  std::vector<uint16_t>     decode_table;
+};
+
+}    // namespace dictionary
+
+namespace impl::dictionary {
+
+constexpr std::array<uint8_t, 3> magic {'C', 'A', 'D'};
+constexpr uint8_t                version = 1;
+
+}    // namespace impl::dictionary
+
+namespace dictionary {
+
+/***
+ * @brief table of lengths, codes and decode table derived
+ * @throws std::invalid_argument if a byte has no code, a code is longer
+ * than impl::order1::max_code_length or the lengths are no prefix code
+ ***/
+inline table make_table(uint32_t                         id,
+                        uint8_t                          rule,
+                        size_t                           section_size,
+                        uint8_t                          depth,
+                        const impl::order1::bit_lengths& lengths) {
+  if (section_size == 0) {
+    throw std::invalid_argument("section_size must be positive");
+  }
+  if (std::find(lengths.begin(), lengths.end(), 0) != lengths.end()) {
+    throw std::invalid_argument("dictionary table must code every byte");
+  }
+
+  table result {.id           = id,
+                .rule         = rule,
+                .section_size = section_size,
+                .depth        = depth,
+                .lengths      = lengths,
+                .codes        = {},
+                .decode_table = std::vector<uint16_t>(
+                impl::order1::table_size)};
+
+  try {
+    impl::order1::build_decode_table(lengths, result.decode_table.data());
+  } catch (const std::runtime_error& error) {
+    throw std::invalid_argument(error.what());
+  }
+  impl::order1::canonical_codes(lengths, result.codes);
+
+  return result;
+}
+
+// tables by id, for decoders of messages of several tables
+class registry {
+  std::vector<table> tables;
+
+public:
+  // replaces a table of the same id
+  void insert(table added) {
+    const auto found = std::find_if(
+    tables.begin(), tables.end(), [&](const table& entry) {
+      return entry.id == added.id;
+    });
+    if (found != tables.end()) {
+      *found = std::move(added);
+    } else {
+      tables.push_back(std::move(added));
+    }
+  }
+
+  // nullptr if no table has the id
+  const table* find(uint32_t id) const {
+    const auto found = std::find_if(
+    tables.begin(), tables.end(), [&](const table& entry) {
+      return entry.id == id;
+    });
+    return found != tables.end() ? &*found : nullptr;
+  }
+};
+
+// Table format:
+// (3 bytes) magic -> (byte) version -> (varint) id -> (byte) rule
+// -> (byte) depth -> (varint) section size
+// -> (128 bytes) code length of every byte, 4 bits each, high nibble first
+
+template<typename ItrOut>
+ItrOut save(const table& table, ItrOut out) {
+  out    = std::copy(impl::dictionary::magic.begin(),
+                     impl::dictionary::magic.end(),
+                     out);
+  *out++ = impl::dictionary::version;
+  out    = util::write_varint(out, table.id);
+  *out++ = table.rule;
+  *out++ = table.depth;
+  out    = util::write_varint(out, table.section_size);
+  for (size_t byte = 0; byte < 256; byte += 2) {
+    *out++ =
+    static_cast<uint8_t>(table.lengths[byte] << 4 | table.lengths[byte + 1]);
+  }
+  return out;
+}
+
+/***
+ * @brief table written by save
+ * @throws std::runtime_error if the input is no valid table
+ ***/
+template<typename ItrIn>
+requires std::random_access_iterator<ItrIn>
+table load(ItrIn begin, ItrIn end) {
+  auto       itr       = begin;
+  const auto read_byte = [&] {
+    if (itr == end) {
+      throw std::runtime_error("truncated dictionary");
+    }
+    return static_cast<uint8_t>(*itr++);
+  };
+
+  for (const uint8_t expected : impl::dictionary::magic) {
+    if (read_byte() != expected) {
+      throw std::runtime_error("not a cacompress dictionary");
+    }
+  }
+  if (read_byte() != impl::dictionary::version) {
+    throw std::runtime_error("unsupported dictionary version");
+  }
+
+  const uint64_t id = util::read_varint(itr, end);
+  if (id > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("invalid dictionary id");
+  }
+  const uint8_t rule         = read_byte();
+  const uint8_t depth        = read_byte();
+  const size_t  section_size = util::read_varint(itr, end);
+
+  impl::order1::bit_lengths lengths;
+  for (size_t byte = 0; byte < 256; byte += 2) {
+    const uint8_t packed = read_byte();
+    lengths[byte]        = packed >> 4;
+    lengths[byte + 1]    = packed & 0x0F;
+  }
+
+  try {
+    return make_table(static_cast<uint32_t>(id),
+                      rule,
+                      section_size,
+                      depth,
+                      lengths);
+  } catch (const std::invalid_argument& error) {
+    throw std::runtime_error(error.what());
+  }
+}
+
+// Output format:
+// (varint) table id -> (varint) byte count -> (bits) msg -> (bits) pad to byte
+
+// encode with the codes of table, no tree is built or written
+template<typename ItrIn, typename ItrOut>
+requires std::forward_iterator<ItrIn> &&
+         std::output_iterator<ItrOut, uint8_t>
+void encode(ItrIn begin, ItrIn end, ItrOut out, const table& table) {
+  impl::stats::stage_timer timer {&stats::counters::huffman_output};
+
+  const auto count = static_cast<uint64_t>(std::distance(begin, end));
+
+  std::array<uint8_t, 32> header;
+
+  auto header_end = util::write_varint(header.begin(), table.id);
+  header_end      = util::write_varint(header_end, count);
+  for (auto itr = header.begin(); itr != header_end; ++itr) {
+    *out++ = *itr;
+  }
+
+  size_t                   msg_bit_size = 0;
+  impl::order1::bit_packer packer {out};
+  for (auto itr = begin; itr != end; ++itr) {
+    const uint8_t byte  = *itr;
+    msg_bit_size       += table.lengths[byte];
+    packer.write(table.codes[byte], table.lengths[byte]);
+  }
+  packer.flush();
+
+  impl::stats::record([&](::stats::counters& stats) {
+    stats.compress_bytes_out +=
+    static_cast<size_t>(header_end - header.begin()) +
+    (msg_bit_size + 7) / 8;
+  });
+}
+
+/***
+ * @brief table id of a message of encode, to find its table before decoding
+ * @throws std::runtime_error on truncated input
+ ***/
+template<typename ItrIn>
+requires std::random_access_iterator<ItrIn>
+uint32_t table_id(ItrIn begin, ItrIn end) {
+  const uint64_t id = util::read_varint(begin, end);
+  if (id > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("invalid dictionary id");
+  }
+  return static_cast<uint32_t>(id);
+}
+
+/***
+ * @brief decode of the first limit bytes only, decoding stops after them
+ * @throws std::runtime_error if registry has no table of the message's id or
+ * on malformed input
+ ***/
+template<typename ItrIn, typename ItrOut>
+requires std::random_access_iterator<ItrIn> &&
+         std::output_iterator<ItrOut, uint8_t>
+void decode(ItrIn           begin,
+            ItrIn           end,
+            ItrOut          out,
+            const registry& registry,
+            size_t          limit) {
+  impl::stats::stage_timer timer {&stats::counters::huffman_decode};
+
+  const table* found = registry.find(table_id(begin, end));
+  if (found == nullptr) {
+    throw std::runtime_error("unknown dictionary table");
+  }
+
+  auto itr = begin;
+  util::read_varint(itr, end);
+  const uint64_t count = util::read_varint(itr, end);
+
+  const uint16_t* decode_table = found->decode_table.data();
+
+  impl::order1::bit_unpacker reader {itr, end};
+  const size_t               symbols = std::min<uint64_t>(count, limit);
+  for (size_t idx = 0; idx < symbols; ++idx) {
+    reader.refill();
+    const uint16_t entry =
+    decode_table[reader.peek(impl::order1::max_code_length)];
+
+    const size_t length = entry >> 8;
+    if (length == 0) {
+      throw std::runtime_error("invalid code");
+    }
+    reader.consume(length);
+    *out++ = static_cast<uint8_t>(entry);
+  }
+}
+
+template<typename ItrIn, typename ItrOut>
+requires std::random_access_iterator<ItrIn> &&
+         std::output_iterator<ItrOut, uint8_t>
+void decode(ItrIn begin, ItrIn end, ItrOut out, const registry& registry) {
+  decode(begin, end, out, registry, std::numeric_limits<size_t>::max());
+}
+
+}    // namespace dictionary
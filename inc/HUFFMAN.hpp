@@ -1,16 +1,20 @@
 #pragma once
 
+#include "STATS.hpp"
 #include "UTIL.hpp"
 
+#include <algorithm>
 #include <array>
 #include <bitset>
 #include <compare>
 #include <cstddef>
 #include <cstdint>
+#include <limits>
 #include <optional>
 #include <queue>
 #include <ranges>
 #include <stack>
+#include <thread>
 #include <vector>
 
 namespace impl::huffman {
@@ -24,17 +28,80 @@ struct code {
 
 using byte = std::optional<uint8_t>;
 
-struct huffman_node {
-  size_t        frequency;
-  huffman_node* left;
-  huffman_node* right;
-  byte          byte;
+/***
+ * @brief huffman tree of the encoder on index arrays
+ * @note nodes [0, leaves) are the leaves by ascending frequency, the internal
+ * nodes follow in the order they are merged, so children always have lower
+ * indices than their parent and the root is the last node
+ ***/
+struct index_tree {
+  std::array<size_t, 256 * 2 - 1> weights;
+  std::array<uint16_t, 256 - 1>   left;    // by internal node - leaves
+  std::array<uint16_t, 256 - 1>   right;
+  std::array<uint8_t, 256>        symbols;    // byte of each leaf
+  uint16_t                        leaves;
+
+  uint16_t root() const {
+    return 2 * leaves - 2;
+  }
 
-  constexpr std::weak_ordering operator<=>(const huffman_node& other) const {
-    return frequency <=> other.frequency;
+  bool is_leaf(uint16_t node) const {
+    return node < leaves;
   }
 };
 
+/***
+ * @brief builds the tree of the non zero counts in linear time after a sort
+ * @note two queue method: merged nodes are created in ascending weight, so
+ * the two lightest nodes are always at the front of either the sorted leaves
+ * or the merged nodes and no heap is needed. Leaves win ties, which keeps
+ * codes short.
+ ***/
+inline void build_tree(index_tree& tree, const std::array<size_t, 256>& freq) {
+  // frequency and byte in one key, ties sort by byte
+  std::array<uint64_t, 256> keys;
+  uint16_t                  leaves = 0;
+  for (size_t byte = 0; byte < 256; ++byte) {
+    if (freq[byte] != 0) {
+      keys[leaves++] = uint64_t {freq[byte]} << 8 | byte;
+    }
+  }
+  tree.leaves = leaves;
+
+  std::sort(keys.begin(), keys.begin() + leaves);
+
+  for (uint16_t leaf = 0; leaf < leaves; ++leaf) {
+    tree.symbols[leaf] = static_cast<uint8_t>(keys[leaf]);
+    tree.weights[leaf] = keys[leaf] >> 8;
+  }
+
+  if (leaves == 0) {
+    return;
+  }
+
+  uint16_t next_leaf = 0;
+  uint16_t next_node = leaves;
+  uint16_t node_end  = leaves;
+
+  const auto lightest = [&] {
+    if (next_leaf < leaves &&
+        (next_node == node_end ||
+         tree.weights[next_leaf] <= tree.weights[next_node])) {
+      return next_leaf++;
+    }
+    return next_node++;
+  };
+
+  for (; node_end < tree.root() + 1; ++node_end) {
+    const uint16_t left  = lightest();
+    const uint16_t right = lightest();
+
+    tree.left[node_end - leaves]  = left;
+    tree.right[node_end - leaves] = right;
+    tree.weights[node_end]        = tree.weights[left] + tree.weights[right];
+  }
+}
+
 struct huffman_decode_node {
   huffman_decode_node* left;
   huffman_decode_node* right;
@@ -52,32 +119,37 @@ constexpr void write_code(util::bit_writer<Itr>& writer, code code) {
   }
 }
 
-void traverse_node(huffman_node* node, auto& table, code code) {
-  if (node->byte.has_value()) {
-    table[node->byte.value()] = code;
+void traverse_node(const index_tree& tree,
+                   uint16_t          node,
+                   auto&             table,
+                   code              code) {
+  if (tree.is_leaf(node)) {
+    table[tree.symbols[node]] = code;
   } else {
     traverse_node(
-    node->left,
+    tree,
+    tree.left[node - tree.leaves],
     table,
     huffman::code {.bits  = code.bits << 1,
                    .count = static_cast<uint8_t>(code.count + 1)});
 
     traverse_node(
-    node->right,
+    tree,
+    tree.right[node - tree.leaves],
     table,
     huffman::code {.bits = code.bits << 1 |= 1,
                    .count = static_cast<uint8_t>(code.count + 1)});
   }
 }
 
-void encode_tree(huffman_node* node, auto& writer) {
-  if (node->byte.has_value()) {
+void encode_tree(const index_tree& tree, uint16_t node, auto& writer) {
+  if (tree.is_leaf(node)) {
     writer.template write_bit<1>();
-    writer.write_byte(node->byte.value());
+    writer.write_byte(tree.symbols[node]);
   } else {
     writer.template write_bit<0>();
-    encode_tree(node->left, writer);
-    encode_tree(node->right, writer);
+    encode_tree(tree, tree.left[node - tree.leaves], writer);
+    encode_tree(tree, tree.right[node - tree.leaves], writer);
   }
 }
 
@@ -103,89 +175,161 @@ huffman_decode_node* decode_tree(auto& itr, auto& reader) {
 
 namespace huffman {
 
-template<typename ItrIn, typename ItrOut>
-requires std::forward_iterator<ItrIn> &&
-         std::output_iterator<ItrOut, uint8_t>
-void encode(ItrIn begin, ItrIn end, ItrOut out) {
-  std::array<impl::huffman::huffman_node, 256 * 2 - 1>
-  tree;    // size is num of huffman nodes for max symbols, this holds lifetimes of nodes
+// node and code storage of encode(), reusable across calls
+struct encode_context {
+  impl::huffman::index_tree            tree;
+  std::array<impl::huffman::code, 256> codes_by_byte;
+  std::vector<uint8_t> output;    // of encode_parallel, written out of order
+};
 
-  const auto tree_begin = tree.begin();
-  auto       tree_end   = tree.begin();
+// node storage of decode(), reusable across calls
+struct decode_context {
+  std::array<impl::huffman::huffman_decode_node, 256 * 2 - 1> tree;
+};
 
-  size_t tree_bit_size = 0;
+}    // namespace huffman
 
-  // make leaf nodes
-  std::array<std::optional<uint16_t>, 256> cache_idx {};
-  for (auto itr = begin; itr != end; ++itr) {
-    const uint8_t byte = *itr;
+namespace impl::huffman {
 
-    if (!cache_idx[byte].has_value()) {
-      tree_bit_size += 10;
+// tree and codes of the non zero counts, @return tree size in bits, 0 if none
+inline size_t build_codes(::huffman::encode_context&     context,
+                          const std::array<size_t, 256>& freq_by_byte) {
+  auto& tree = context.tree;
+  build_tree(tree, freq_by_byte);
 
-      cache_idx[byte] =
-      static_cast<int16_t>(std::distance(tree.begin(), tree_end));
-      *tree_end++ = {.frequency = 1,
-                     .left      = nullptr,
-                     .right     = nullptr,
-                     .byte      = byte};
-    } else {
-      ++tree[*cache_idx[byte]].frequency;
-    }
+  if (tree.leaves == 0) {
+    return 0;
   }
 
-  --tree_bit_size;
-  std::array<size_t, 256> freq_by_byte {};
-  for (auto itr = tree_begin; itr != tree_end; ++itr) {
-    freq_by_byte[itr->byte.value()] = itr->frequency;
-  }
-
-  // make intermediate nodes
-  std::make_heap(tree_begin, tree_end, std::greater {});
-  auto park_itr = tree.rbegin();
-  while (std::distance(tree_begin, tree_end) > 1) {
-    std::pop_heap(tree_begin, tree_end, std::greater {});
-    *park_itr++ = *(--tree_end);
-    std::pop_heap(tree_begin, tree_end, std::greater {});
-    *park_itr++ = *(--tree_end);
-    *tree_end++ = impl::huffman::huffman_node {
-      .frequency = (park_itr - 2)->frequency + (park_itr - 1)->frequency,
-      .left      = std::to_address(park_itr - 2),
-      .right     = std::to_address(park_itr - 1),
-      .byte      = std::nullopt};
-    std::push_heap(tree_begin, tree_end, std::greater {});
-  }
-
-  // Output format:
-  // (byte) pad bits count -> (bits) tree -> (bits) msg -> (bits) pad to byte
-
-  std::array<impl::huffman::code, 256> codes_by_byte {};
-
-  if (tree_begin->byte.has_value()) {    // corner case for single byte repeated
-    codes_by_byte[tree_begin->byte.value()] = {.bits  = {1},
-                                               .count = 1};    // 1 bit code
+  // only codes of bytes in the input are set and read
+  auto& codes_by_byte = context.codes_by_byte;
+
+  if (tree.leaves == 1) {    // corner case for single byte repeated
+    codes_by_byte[tree.symbols[0]] = {.bits = {1}, .count = 1};    // 1 bit code
   } else {
     // codes -> left is 0, right is 1
-    impl::huffman::traverse_node(std::to_address(tree_begin),
-                                 codes_by_byte,
-                                 impl::huffman::code {.bits = {0}, .count = 0});
+    traverse_node(tree,
+                  tree.root(),
+                  codes_by_byte,
+                  code {.bits = {0}, .count = 0});
   }
 
-  util::bit_writer writer {out};
+  // 10 bits per leaf, 1 per internal node
+  return 10 * size_t {tree.leaves} - 1;
+}
+
+// 1 + tree_size + msg_size -> to be written, first bit is 1 for no pad and 0
+// for pad
+inline uint8_t pad_bits_of(size_t tree_bit_size, size_t msg_bit_size) {
+  return 8 - ((8 + tree_bit_size + msg_bit_size) % 8);
+}
+
+inline void record_output(const ::huffman::encode_context& context,
+                          const std::array<size_t, 256>&   freq_by_byte,
+                          size_t                           tree_bit_size,
+                          size_t                           msg_bit_size,
+                          uint8_t                          pad_bits) {
+  impl::stats::record([&](::stats::counters& stats) {
+    for (size_t i = 0; i < 256; ++i) {
+      if (freq_by_byte[i] != 0) {
+        ++stats.code_lengths[context.codes_by_byte[i].count];
+        stats.max_tree_depth = std::max<uint64_t>(
+        stats.max_tree_depth, context.codes_by_byte[i].count);
+      }
+    }
+    stats.compress_bytes_out +=
+    (8 + tree_bit_size + msg_bit_size + pad_bits) / 8;
+  });
+}
+
+/***
+ * @brief output iterator of one chunk of encode_parallel
+ * @note a chunk starting inside a byte shares it with the chunk before, its
+ * part of that byte goes to shared instead and is merged after the join, so
+ * no byte is written by two threads
+ ***/
+class chunk_iterator {
+  uint8_t* output;
+  uint8_t* shared;
+
+public:
+  chunk_iterator(uint8_t* output, uint8_t* shared):
+    output(output),
+    shared(shared) {
+  }
+
+  uint8_t& operator*() const {
+    return shared != nullptr ? *shared : *output;
+  }
+
+  chunk_iterator& operator++() {
+    shared = nullptr;
+    ++output;
+    return *this;
+  }
+
+  chunk_iterator operator++(int) {
+    auto copy = *this;
+    ++*this;
+    return copy;
+  }
+};
+
+}    // namespace impl::huffman
+
+namespace huffman {
+
+// Output format:
+// (byte) pad bits count -> (bits) tree -> (bits) msg -> (bits) pad to byte
+
+/***
+ * @brief encode with the byte counts of [begin, end) given
+ * @note freq_by_byte must be the histogram of the input, callers that
+ * already keep one, like the SOCA search, skip counting it again
+ ***/
+template<typename ItrIn, typename ItrOut>
+requires std::forward_iterator<ItrIn> &&
+         std::output_iterator<ItrOut, uint8_t>
+void encode(ItrIn                          begin,
+            ItrIn                          end,
+            ItrOut                         out,
+            encode_context&                context,
+            const std::array<size_t, 256>& freq_by_byte) {
+  impl::stats::stage_timer tree_timer {&stats::counters::huffman_tree};
+
+  const size_t tree_bit_size =
+  impl::huffman::build_codes(context, freq_by_byte);
+  if (tree_bit_size == 0) {
+    return;
+  }
+  const auto& codes_by_byte = context.codes_by_byte;
+
+  tree_timer.stop();
+  impl::stats::stage_timer output_timer {&stats::counters::huffman_output};
 
-  // Pad bits count output
-  // 1 + tree_size + msg_size -> to be written, first bit is 1 for no pad and 0 for pad
   size_t msg_bit_size = 0;
   for (size_t i = 0; i < 256; ++i) {
-    msg_bit_size += codes_by_byte[i].count * freq_by_byte[i];
+    if (freq_by_byte[i] != 0) {
+      msg_bit_size += codes_by_byte[i].count * freq_by_byte[i];
+    }
   }
 
-  const uint8_t pad_bits = 8 - ((8 + tree_bit_size + msg_bit_size) % 8);
+  const uint8_t pad_bits =
+  impl::huffman::pad_bits_of(tree_bit_size, msg_bit_size);
+
+  impl::huffman::record_output(context,
+                               freq_by_byte,
+                               tree_bit_size,
+                               msg_bit_size,
+                               pad_bits);
 
+  util::bit_writer writer {out};
+
+  // Pad bits count output
   writer.write_byte(pad_bits);
 
   // Tree output
-  impl::huffman::encode_tree(std::to_address(tree_begin), writer);
+  impl::huffman::encode_tree(context.tree, context.tree.root(), writer);
 
   // Msg output
   for (auto itr = begin; itr != end; ++itr) {
@@ -198,12 +342,162 @@ void encode(ItrIn begin, ItrIn end, ItrOut out) {
   }
 }
 
+template<typename ItrIn, typename ItrOut>
+requires std::forward_iterator<ItrIn> &&
+         std::output_iterator<ItrOut, uint8_t>
+void encode(ItrIn begin, ItrIn end, ItrOut out, encode_context& context) {
+  std::array<size_t, 256> freq_by_byte {};
+  util::count_bytes(begin, end, freq_by_byte);
+  encode(begin, end, out, context, freq_by_byte);
+}
+
+template<typename ItrIn, typename ItrOut>
+requires std::forward_iterator<ItrIn> &&
+         std::output_iterator<ItrOut, uint8_t>
+void encode(ItrIn begin, ItrIn end, ItrOut out) {
+  encode_context context;
+  encode(begin, end, out, context);
+}
+
+// inputs below this per worker are encoded by the serial encode
+inline constexpr size_t min_parallel_chunk = 64 * 1024;
+
+/***
+ * @brief encode with the message bits written by up to threads workers
+ * @note the input is split into chunks, their bit sizes are summed in
+ * parallel and prefix summed into bit offsets, then every chunk is written
+ * straight to its place in context.output. Byte identical to encode.
+ * threads 0 uses all cores.
+ ***/
+template<typename ItrIn, typename ItrOut>
+requires std::forward_iterator<ItrIn> &&
+         std::output_iterator<ItrOut, uint8_t>
+void encode_parallel(ItrIn                          begin,
+                     ItrIn                          end,
+                     ItrOut                         out,
+                     encode_context&                context,
+                     const std::array<size_t, 256>& freq_by_byte,
+                     size_t                         threads = 0) {
+  if (threads == 0) {
+    threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  }
+
+  const auto   size   = static_cast<size_t>(std::distance(begin, end));
+  const size_t chunks = std::min(threads, size / min_parallel_chunk);
+  if (chunks <= 1) {
+    encode(begin, end, out, context, freq_by_byte);
+    return;
+  }
+
+  impl::stats::stage_timer tree_timer {&stats::counters::huffman_tree};
+
+  const size_t tree_bit_size =
+  impl::huffman::build_codes(context, freq_by_byte);
+  const auto& codes_by_byte = context.codes_by_byte;
+
+  tree_timer.stop();
+  impl::stats::stage_timer output_timer {&stats::counters::huffman_output};
+
+  // chunk idx is [starts[idx], starts[idx + 1])
+  std::vector<ItrIn> starts;
+  starts.reserve(chunks + 1);
+  starts.push_back(begin);
+  for (size_t chunk = 1; chunk < chunks; ++chunk) {
+    starts.push_back(
+    std::next(starts.back(), static_cast<ptrdiff_t>(size / chunks)));
+  }
+  starts.push_back(end);
+
+  // bit sizes, then prefix summed into bit offsets after the tree
+  std::vector<size_t> offsets(chunks + 1, 0);
+  util::parallel_for(chunks, threads, [&](size_t chunk) {
+    size_t bits = 0;
+    for (auto itr = starts[chunk]; itr != starts[chunk + 1]; ++itr) {
+      bits += codes_by_byte[*itr].count;
+    }
+    offsets[chunk + 1] = bits;
+  });
+
+  offsets[0] = 8 + tree_bit_size;
+  for (size_t chunk = 0; chunk < chunks; ++chunk) {
+    offsets[chunk + 1] += offsets[chunk];
+  }
+
+  const size_t  msg_bit_size = offsets.back() - offsets.front();
+  const uint8_t pad_bits =
+  impl::huffman::pad_bits_of(tree_bit_size, msg_bit_size);
+
+  impl::huffman::record_output(context,
+                               freq_by_byte,
+                               tree_bit_size,
+                               msg_bit_size,
+                               pad_bits);
+
+  // zeroed, every writer ors its bits into a zero byte
+  auto& output = context.output;
+  output.assign((offsets.back() + pad_bits) / 8, 0);
+
+  util::bit_writer header {output.data()};
+  header.write_byte(pad_bits);
+  impl::huffman::encode_tree(context.tree, context.tree.root(), header);
+  if (offsets.front() % 8 != 0) {
+    header.flush();
+  }
+
+  std::vector<uint8_t> shared(chunks, 0);
+  util::parallel_for(chunks, threads, [&](size_t chunk) {
+    const size_t offset = offsets[chunk];
+
+    util::bit_writer writer {impl::huffman::chunk_iterator {
+      output.data() + offset / 8,
+      offset % 8 != 0 ? &shared[chunk] : nullptr}};
+
+    // leading bits belong to the chunk before
+    for (size_t bit = 0; bit < offset % 8; ++bit) {
+      writer.template write_bit<0>();
+    }
+
+    for (auto itr = starts[chunk]; itr != starts[chunk + 1]; ++itr) {
+      impl::huffman::write_code(writer, codes_by_byte[*itr]);
+    }
+
+    if (offsets[chunk + 1] % 8 != 0) {
+      writer.flush();
+    }
+  });
+
+  for (size_t chunk = 0; chunk < chunks; ++chunk) {
+    output[offsets[chunk] / 8] |= shared[chunk];
+  }
+
+  std::copy(output.begin(), output.end(), out);
+}
+
+template<typename ItrIn, typename ItrOut>
+requires std::forward_iterator<ItrIn> &&
+         std::output_iterator<ItrOut, uint8_t>
+void encode_parallel(ItrIn           begin,
+                     ItrIn           end,
+                     ItrOut          out,
+                     encode_context& context,
+                     size_t          threads = 0) {
+  std::array<size_t, 256> freq_by_byte {};
+  util::count_bytes(begin, end, freq_by_byte);
+  encode_parallel(begin, end, out, context, freq_by_byte, threads);
+}
+
+// decode of the first limit bytes only, decoding stops after them
 template<typename ItrIn, typename ItrOut>
 requires std::random_access_iterator<ItrIn> &&
          std::output_iterator<ItrOut, uint8_t>
-void decode(ItrIn begin, ItrIn end, ItrOut out) {
-  std::array<impl::huffman::huffman_decode_node, 256 * 2 - 1>
-  tree;    // size is num of huffman nodes for max symbols, this holds lifetimes of nodes
+void decode(ItrIn           begin,
+            ItrIn           end,
+            ItrOut          out,
+            decode_context& context,
+            size_t          limit) {
+  impl::stats::stage_timer timer {&stats::counters::huffman_decode};
+
+  auto& tree = context.tree;
 
   const size_t bits_to_read =
   (std::distance(std::next(begin), end) * 8) - *begin;
@@ -216,8 +510,8 @@ void decode(ItrIn begin, ItrIn end, ItrOut out) {
   impl::huffman::decode_tree(tree_space_itr, reader);
 
   // Tree bit size calculation
-  for (const auto& node : tree) {
-    if (node.byte.has_value()) {
+  for (auto itr = tree.begin(); itr != tree_space_itr; ++itr) {
+    if (itr->byte.has_value()) {
       bits_read += 10;
     }
   }
@@ -225,13 +519,14 @@ void decode(ItrIn begin, ItrIn end, ItrOut out) {
 
   // Corner case for single byte repeated
   if (root->byte.has_value()) {
-    while (bits_read++ < bits_to_read) {
+    while (bits_read++ < bits_to_read && limit-- != 0) {
       *out++ = root->byte.value();
     }
+    return;
   }
 
   impl::huffman::huffman_decode_node* node = root;
-  while (bits_read < bits_to_read) {
+  for (; bits_read < bits_to_read && limit != 0; --limit) {
     while (!node->byte.has_value()) {
       if (reader.read_bit() == 1) {
         node = node->right;
@@ -246,4 +541,19 @@ void decode(ItrIn begin, ItrIn end, ItrOut out) {
   }
 }
 
+template<typename ItrIn, typename ItrOut>
+requires std::random_access_iterator<ItrIn> &&
+         std::output_iterator<ItrOut, uint8_t>
+void decode(ItrIn begin, ItrIn end, ItrOut out, decode_context& context) {
+  decode(begin, end, out, context, std::numeric_limits<size_t>::max());
+}
+
+template<typename ItrIn, typename ItrOut>
+requires std::random_access_iterator<ItrIn> &&
+         std::output_iterator<ItrOut, uint8_t>
+void decode(ItrIn begin, ItrIn end, ItrOut out) {
+  decode_context context;
+  decode(begin, end, out, context);
+}
+
 }    // namespace huffman
@@ -0,0 +1,283 @@
+#pragma once
+
+#include "COMPRESS.hpp"
+#include "STREAM.hpp"
+#include "TRANSFORM.hpp"
+#include "TUNE.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace level {
+
+constexpr int min_level     = 1;
+constexpr int max_level     = 6;
+constexpr int default_level = 2;
+
+struct settings {
+  uint8_t       depth;               // SOCA generations searched per section
+  size_t        section_size;        // bytes per section
+  size_t        block_size;          // bytes per block, coded with own tables
+  entropy_model entropy;             // coder of the blocks
+  bool          transform_search;    // transform stage chosen on a sample
+  bool          entropy_search;      // coder chosen on a sample
+  bool          section_search;      // section size chosen on a sample
+  size_t        candidate_rules;     // preferred rules tried on a sample
+};
+
+}    // namespace level
+
+namespace impl::level {
+
+// best first on a mixed corpus (text, binary, floats, ints)
+constexpr std::array<uint8_t, 16> preferred_rules {
+220, 68, 196, 140, 76, 12, 172, 100, 44, 228, 236, 132, 108, 136, 204, 164};
+
+// stages a transform search tries alone, after no stage at all
+constexpr std::array<::transform::stage, 5> candidate_stages {{
+{.type = ::transform::kind::delta},
+{.type = ::transform::kind::stride_delta, .distance = 2},
+{.type = ::transform::kind::stride_delta, .distance = 4},
+{.type = ::transform::kind::stride_delta, .distance = 8},
+{.type = ::transform::kind::move_to_front},
+}};
+
+// section sizes a section search tries, sparse data wants the smallest and
+// repetitive data the largest
+constexpr std::array<size_t, 4> candidate_section_sizes {64, 256, 1024, 4096};
+
+// the transform stage, rules and section size set most of the ratio, the
+// searched generations add less and cost the most
+constexpr std::array<::level::settings, ::level::max_level> levels {{
+{.depth            = 0,
+ .section_size     = 64,
+ .block_size       = size_t {1} << 18,
+ .entropy          = entropy_model::order1,
+ .transform_search = false,
+ .entropy_search   = false,
+ .section_search   = false,
+ .candidate_rules  = 1},
+{.depth            = 2,
+ .section_size     = 1024,
+ .block_size       = size_t {1} << 16,
+ .entropy          = entropy_model::order1,
+ .transform_search = false,
+ .entropy_search   = false,
+ .section_search   = false,
+ .candidate_rules  = 1},
+{.depth            = 2,
+ .section_size     = 1024,
+ .block_size       = size_t {1} << 16,
+ .entropy          = entropy_model::order1,
+ .transform_search = true,
+ .entropy_search   = true,
+ .section_search   = false,
+ .candidate_rules  = 1},
+{.depth            = 2,
+ .section_size     = 1024,
+ .block_size       = size_t {1} << 16,
+ .entropy          = entropy_model::order1,
+ .transform_search = true,
+ .entropy_search   = true,
+ .section_search   = true,
+ .candidate_rules  = 1},
+{.depth            = 2,
+ .section_size     = 4096,
+ .block_size       = size_t {1} << 16,
+ .entropy          = entropy_model::order1,
+ .transform_search = true,
+ .entropy_search   = true,
+ .section_search   = false,
+ .candidate_rules  = 16},
+{.depth            = 4,
+ .section_size     = 4096,
+ .block_size       = size_t {1} << 16,
+ .entropy          = entropy_model::order1,
+ .transform_search = true,
+ .entropy_search   = true,
+ .section_search   = true,
+ .candidate_rules  = 16},
+}};
+
+// size of data compressed under params
+inline size_t compressed_size(const std::vector<uint8_t>&  data,
+                              const ::stream::parameters& params) {
+  std::vector<uint8_t> compressed;
+  ::stream::compress(
+  data.begin(), data.end(), std::back_inserter(compressed), params);
+  return compressed.size();
+}
+
+/***
+ * @brief transform stage, or none, that compresses sample smallest under
+ * params
+ * @note no stage wins ties
+ ***/
+inline std::vector<::transform::stage> choose_transforms(
+const std::vector<uint8_t>& sample,
+const ::stream::parameters& params) {
+  // stages are compared without searching generations, which are slow
+  ::stream::parameters trial = params;
+  trial.depth                = 0;
+
+  std::vector<::transform::stage> best;
+  size_t                          best_size = compressed_size(sample, trial);
+
+  for (const auto& stage : candidate_stages) {
+    trial.transforms = {stage};
+
+    const size_t size = compressed_size(sample, trial);
+    if (size < best_size) {
+      best_size = size;
+      best      = trial.transforms;
+    }
+  }
+
+  return best;
+}
+
+/***
+ * @brief coder, params.entropy or order0, that compresses sample smallest
+ * @note order0 pays off on small inputs, where the tables of order1 cost
+ * more than they win, params.entropy wins ties
+ ***/
+inline entropy_model choose_entropy(const std::vector<uint8_t>& sample,
+                                    const ::stream::parameters& params) {
+  ::stream::parameters trial = params;
+  trial.depth                = 0;
+
+  const size_t size = compressed_size(sample, trial);
+  trial.entropy     = entropy_model::order0;
+
+  if (compressed_size(sample, trial) < size) {
+    return entropy_model::order0;
+  }
+  return params.entropy;
+}
+
+/***
+ * @brief params with the rule among the first count preferred_rules, and the
+ * section size among candidate_section_sizes if resize, that compress sample
+ * smallest
+ * @note rules are tried with the whole stream configuration, transforms and
+ * coder included, the earlier size and rule win ties. Searched generations
+ * can cost more in count bytes than they win, every size is also tried
+ * searching none, which wins ties with the rules.
+ ***/
+inline ::stream::parameters choose_rule(const std::vector<uint8_t>& sample,
+                                        const ::stream::parameters& params,
+                                        size_t                      count,
+                                        bool                        resize) {
+  const size_t            table_size[]  = {params.section_size};
+  std::span<const size_t> section_sizes = table_size;
+  if (resize) {
+    section_sizes = candidate_section_sizes;
+  }
+
+  ::stream::parameters best      = params;
+  size_t               best_size = std::numeric_limits<size_t>::max();
+
+  ::stream::parameters trial = params;
+  for (const size_t section_size : section_sizes) {
+    trial.section_size = section_size;
+    trial.depth        = 0;
+
+    size_t size = compressed_size(sample, trial);
+    if (size < best_size) {
+      best_size = size;
+      best      = trial;
+    }
+
+    trial.depth = params.depth;
+    for (size_t idx = 0; idx < std::min(count, preferred_rules.size()); ++idx) {
+      trial.rule = preferred_rules[idx];
+
+      size = compressed_size(sample, trial);
+      if (size < best_size) {
+        best_size = size;
+        best      = trial;
+      }
+    }
+  }
+
+  return best;
+}
+
+}    // namespace impl::level
+
+namespace level {
+
+/***
+ * @brief concrete settings of a compression level
+ * @throws std::invalid_argument if level is outside [min_level, max_level]
+ ***/
+constexpr settings settings_of(int level) {
+  if (level < min_level || level > max_level) {
+    throw std::invalid_argument("compression level out of range");
+  }
+  return impl::level::levels[level - min_level];
+}
+
+/***
+ * @brief stream::compress with the settings of a compression level
+ * @note searches run on a sample of the input and their choices are recorded
+ * in the stream header, the whole input is compressed once. Searched
+ * generations are kept only if they compress the sample smaller.
+ * @note ratio and MB/s measured on 64 KiB each of source text, an x86-64
+ * binary, float and int arrays and random bytes, single thread; corpus is
+ * the ratio over the 64 KiB datasets of the bench corpus:
+ * | level | ratio  | MB/s  | decompress MB/s | corpus |
+ * |-------|--------|-------|-----------------|--------|
+ * | 1     | 1.1760 | 40.07 | 89.19           | 1.6147 |
+ * | 2     | 1.3382 | 12.00 | 113.71          | 1.6816 |
+ * | 3     | 1.3891 | 4.04  | 50.83           | 1.7417 |
+ * | 4     | 1.3891 | 2.64  | 50.35           | 1.7639 |
+ * | 5     | 1.3884 | 1.89  | 47.20           | 1.8736 |
+ * | 6     | 1.3891 | 0.53  | 44.53           | 1.8974 |
+ * the transform stage sets most of the ratio of mixed input, the searched
+ * section sizes and rules of levels 4 and up pay off on sparse and
+ * repetitive data. Deeper searches, and rule counts between 1 and 16,
+ * measured no better; order0 wins on small inputs only.
+ * @throws std::invalid_argument if level is outside [min_level, max_level]
+ ***/
+template<typename ItrIn, typename ItrOut>
+requires std::random_access_iterator<ItrIn>
+ItrOut compress(ItrIn begin, ItrIn end, ItrOut out, int level = default_level) {
+  const settings chosen = settings_of(level);
+
+  stream::parameters params {.rule         = impl::level::preferred_rules[0],
+                             .section_size = chosen.section_size,
+                             .depth        = chosen.depth,
+                             .block_size   = chosen.block_size,
+                             .entropy      = chosen.entropy};
+
+  if (!chosen.transform_search && !chosen.entropy_search &&
+      !chosen.section_search && params.depth == 0) {
+    return stream::compress(begin, end, out, params);
+  }
+
+  // the sample is that of tune::tune
+  const auto sample = impl::tune::sample(begin, end, tune::search_space {});
+  if (chosen.transform_search) {
+    params.transforms = impl::level::choose_transforms(sample, params);
+  }
+  if (chosen.entropy_search) {
+    params.entropy = impl::level::choose_entropy(sample, params);
+  }
+
+  if (chosen.section_search || params.depth > 0) {
+    params = impl::level::choose_rule(
+    sample, params, chosen.candidate_rules, chosen.section_search);
+  }
+
+  return stream::compress(begin, end, out, params);
+}
+
+}    // namespace level
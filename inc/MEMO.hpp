@@ -0,0 +1,176 @@
+#pragma once
+
+#include "STATS.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+// Memo of section searches. Inputs with repeated sections, fixed headers,
+// padding or repeated records, search every distinct section once, later
+// occurrences take the remembered count and transformed bytes. Compression
+// uses one when compression_context::memo is set.
+
+namespace impl::memo {
+
+// multiplicative hash, 8 bytes per step
+inline uint64_t hash(const uint8_t* data, size_t size, uint64_t seed) {
+  constexpr uint64_t multiplier = 0x9E3779B97F4A7C15;
+
+  uint64_t result = (seed ^ size) * multiplier;
+
+  size_t idx = 0;
+  for (; idx + 8 <= size; idx += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + idx, 8);
+    result  = (result ^ word) * multiplier;
+    result ^= result >> 29;
+  }
+
+  uint64_t tail = 0;
+  std::memcpy(&tail, data + idx, size - idx);
+  result = (result ^ tail) * multiplier;
+
+  return result ^ result >> 32;
+}
+
+/***
+ * @brief slots of a cache of slot_count slots, rounded up to a power of 2
+ * @throws std::invalid_argument for no slots, max_section of 0 or a cache
+ * too large to allocate
+ ***/
+inline size_t slot_count_of(size_t slot_count, size_t max_section) {
+  if (slot_count == 0 || max_section == 0) {
+    throw std::invalid_argument("memo cache must hold sections");
+  }
+  // largest power of 2 a size_t holds, bit_ceil of more is undefined
+  constexpr size_t max_size  = std::numeric_limits<size_t>::max();
+  constexpr size_t max_slots = max_size / 2 + 1;
+  if (slot_count > max_slots ||
+      std::bit_ceil(slot_count) > max_size / max_section) {
+    throw std::invalid_argument("memo cache too large");
+  }
+  return std::bit_ceil(slot_count);
+}
+
+}    // namespace impl::memo
+
+namespace memo {
+
+/***
+ * @brief bounded cache of section searches, keyed by a hash of the section
+ * and the settings of its search
+ * @note direct mapped, a slot keeps the last section hashed to it. Slots
+ * hold the section itself, so a hash collision is a miss and never a wrong
+ * result. Sections over max_section bytes bypass the cache. Memory is twice
+ * slot_count * max_section bytes.
+ * @throws std::invalid_argument (ctor) for no slots, max_section of 0 or
+ * more memory than size_t counts
+ ***/
+class cache {
+  struct slot {
+    uint64_t hash     = 0;
+    uint64_t settings = 0;
+    uint32_t size     = 0;    // 0 for an empty slot
+    uint8_t  count    = 0;
+  };
+
+  size_t               max_section;
+  std::vector<slot>    slots;
+  std::vector<uint8_t> originals;    // section of every slot
+  std::vector<uint8_t> results;      // transformed section of every slot
+
+  uint64_t hit_count  = 0;
+  uint64_t miss_count = 0;
+
+public:
+  // checks the sizes before any buffer is allocated
+  explicit cache(size_t slot_count = 4096, size_t max_section = 128)
+  : max_section(max_section),
+    slots(impl::memo::slot_count_of(slot_count, max_section)),
+    originals(slots.size() * max_section),
+    results(slots.size() * max_section) {
+  }
+
+  /***
+   * @brief count of a search of section under settings, section is left
+   * transformed by it
+   * @note a miss runs search(), which transforms section in place and
+   * returns the count, and remembers the result. A hit calls
+   * replay(result, count) while section still holds the original bytes, then
+   * copies the result into section.
+   ***/
+  template<typename Search, typename Replay>
+  uint8_t search(uint64_t           settings,
+                 std::span<uint8_t> section,
+                 Search             search,
+                 Replay             replay) {
+    const size_t size = section.size();
+    if (size == 0 || size > max_section) {
+      return search();
+    }
+
+    const uint64_t key = impl::memo::hash(section.data(), size, settings);
+    const size_t   idx = key & (slots.size() - 1);
+
+    slot&    entry    = slots[idx];
+    uint8_t* original = originals.data() + idx * max_section;
+    uint8_t* result   = results.data() + idx * max_section;
+
+    if (entry.size == size && entry.hash == key &&
+        entry.settings == settings &&
+        std::equal(section.begin(), section.end(), original)) {
+      ++hit_count;
+      impl::stats::record(
+      [](::stats::counters& stats) { ++stats.memo_hits; });
+
+      replay(std::span<const uint8_t> {result, size}, entry.count);
+      std::copy(result, result + size, section.begin());
+      return entry.count;
+    }
+
+    ++miss_count;
+    impl::stats::record([](::stats::counters& stats) { ++stats.memo_misses; });
+
+    std::copy(section.begin(), section.end(), original);
+    const uint8_t count = search();
+    std::copy(section.begin(), section.end(), result);
+
+    entry = {.hash     = key,
+             .settings = settings,
+             .size     = static_cast<uint32_t>(size),
+             .count    = count};
+    return count;
+  }
+
+  uint64_t hits() const {
+    return hit_count;
+  }
+
+  uint64_t misses() const {
+    return miss_count;
+  }
+
+  // hits among the cached searches, 0 before any
+  double hit_rate() const {
+    const uint64_t total = hit_count + miss_count;
+    return total == 0 ? 0.0
+                      : static_cast<double>(hit_count) /
+                        static_cast<double>(total);
+  }
+
+  // forgets every section and the hit statistics
+  void clear() {
+    std::fill(slots.begin(), slots.end(), slot {});
+    hit_count  = 0;
+    miss_count = 0;
+  }
+};
+
+}    // namespace memo
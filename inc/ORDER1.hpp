@@ -0,0 +1,673 @@
+#pragma once
+
+#include "HUFFMAN.hpp"
+#include "STATS.hpp"
+#include "UTIL.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+// Order-1 entropy coder: the previous byte selects the Huffman table of the
+// next. The 256 previous bytes are clustered by the statistics of the bytes
+// that follow them into up to max_clusters tables, few enough to send and to
+// keep in cache. Codes are canonical and at most max_code_length bits long,
+// so the decoder resolves a byte with one lookup in the table of its cluster.
+
+namespace impl::order1 {
+
+constexpr size_t max_code_length = 11;
+constexpr size_t max_clusters    = 8;
+constexpr size_t length_bits     = 4;    // per code length in the header
+constexpr size_t table_size      = size_t {1} << max_code_length;
+
+// refinement rounds of the clustering after the seeds are picked
+constexpr size_t cluster_rounds = 4;
+
+using frequencies = std::array<size_t, 256>;
+using bit_lengths = std::array<uint8_t, 256>;
+
+// bits of a cluster number in the header
+constexpr size_t cluster_bits(size_t clusters) {
+  size_t bits = 0;
+  while ((size_t {1} << bits) < clusters) {
+    ++bits;
+  }
+  return bits;
+}
+
+/***
+ * @brief Huffman code lengths of freq, none above max_code_length
+ * @note overlong codes are cut to the limit, then the least frequent bytes
+ * with shorter codes are lengthened until the Kraft sum fits and the most
+ * frequent shortened while it still does. A single byte gets length 1.
+ ***/
+inline void code_lengths(const frequencies&         freq,
+                         impl::huffman::index_tree& tree,
+                         bit_lengths&               out) {
+  out.fill(0);
+  impl::huffman::build_tree(tree, freq);
+
+  const uint16_t leaves = tree.leaves;
+  if (leaves == 0) {
+    return;
+  }
+  if (leaves == 1) {
+    out[tree.symbols[0]] = 1;
+    return;
+  }
+
+  // top down, children have lower indices than their parent
+  std::array<uint16_t, 256 * 2 - 1> depth;
+  depth[tree.root()] = 0;
+  for (uint16_t node = tree.root(); node >= leaves; --node) {
+    const auto child_depth = static_cast<uint16_t>(depth[node] + 1);
+    depth[tree.left[node - leaves]]  = child_depth;
+    depth[tree.right[node - leaves]] = child_depth;
+  }
+
+  // Kraft sum in units of 2^-max_code_length, leaves ascend in frequency
+  constexpr size_t capacity = table_size;
+
+  size_t kraft = 0;
+  for (uint16_t leaf = 0; leaf < leaves; ++leaf) {
+    depth[leaf]  = std::min<uint16_t>(depth[leaf], max_code_length);
+    kraft       += capacity >> depth[leaf];
+  }
+
+  while (kraft > capacity) {
+    for (uint16_t leaf = 0; leaf < leaves && kraft > capacity; ++leaf) {
+      if (depth[leaf] < max_code_length) {
+        kraft -= capacity >> (depth[leaf] + 1);
+        ++depth[leaf];
+      }
+    }
+  }
+
+  for (uint16_t leaf = leaves; leaf-- > 0;) {
+    while (depth[leaf] > 1 && kraft + (capacity >> depth[leaf]) <= capacity) {
+      kraft += capacity >> depth[leaf];
+      --depth[leaf];
+    }
+    out[tree.symbols[leaf]] = static_cast<uint8_t>(depth[leaf]);
+  }
+}
+
+// canonical codes of the lengths, shorter codes first and ties by byte
+inline void canonical_codes(const bit_lengths&         lengths,
+                            std::array<uint16_t, 256>& codes) {
+  std::array<uint16_t, max_code_length + 1> count {};
+  for (const uint8_t length : lengths) {
+    ++count[length];
+  }
+  count[0] = 0;
+
+  std::array<uint16_t, max_code_length + 1> next {};
+  uint16_t                                  code = 0;
+  for (size_t length = 1; length <= max_code_length; ++length) {
+    code         = static_cast<uint16_t>((code + count[length - 1]) << 1);
+    next[length] = code;
+  }
+
+  for (size_t byte = 0; byte < 256; ++byte) {
+    if (lengths[byte] != 0) {
+      codes[byte] = next[lengths[byte]]++;
+    }
+  }
+}
+
+/***
+ * @brief lookup table of the code of the lengths: entry of the next
+ * max_code_length bits is the byte | its code length << 8, 0 for no code
+ * @throws std::runtime_error if the lengths are no prefix code
+ ***/
+inline void build_decode_table(const bit_lengths& lengths, uint16_t* table) {
+  size_t kraft = 0;
+  for (const uint8_t length : lengths) {
+    if (length > max_code_length) {
+      throw std::runtime_error("invalid code length");
+    }
+    if (length != 0) {
+      kraft += table_size >> length;
+    }
+  }
+  if (kraft > table_size) {
+    throw std::runtime_error("invalid code lengths");
+  }
+
+  std::array<uint16_t, 256> codes;
+  canonical_codes(lengths, codes);
+
+  std::fill(table, table + table_size, uint16_t {0});
+  for (size_t byte = 0; byte < 256; ++byte) {
+    const size_t length = lengths[byte];
+    if (length == 0) {
+      continue;
+    }
+    const size_t first = size_t {codes[byte]} << (max_code_length - length);
+    std::fill(table + first,
+              table + first + (table_size >> length),
+              static_cast<uint16_t>(byte | length << 8));
+  }
+}
+
+// MSB first bit output, up to 32 bits per write
+template<typename ItrOut>
+class bit_packer {
+  ItrOut   output;
+  uint64_t bits {0};
+  size_t   count {0};    // bits not yet written, the low bits of bits
+
+public:
+  explicit bit_packer(ItrOut output): output(output) {
+  }
+
+  void write(uint32_t value, size_t length) {
+    bits   = bits << length | value;
+    count += length;
+    while (count >= 8) {
+      count   -= 8;
+      *output++ = static_cast<uint8_t>(bits >> count);
+    }
+  }
+
+  void flush() {
+    if (count != 0) {
+      *output++ = static_cast<uint8_t>(bits << (8 - count));
+      count     = 0;
+    }
+  }
+};
+
+// MSB first bit input through a 64 bit window, zeros past the end
+template<typename ItrIn>
+class bit_unpacker {
+  ItrIn    input;
+  ItrIn    input_end;
+  uint64_t window {0};
+  size_t   available {0};
+
+public:
+  bit_unpacker(ItrIn input, ItrIn input_end):
+    input(input),
+    input_end(input_end) {
+  }
+
+  // at least 57 bits available unless the input ends
+  void refill() {
+    while (available <= 56 && input != input_end) {
+      const auto byte  = static_cast<uint8_t>(*input++);
+      window          |= uint64_t {byte} << (56 - available);
+      available       += 8;
+    }
+  }
+
+  // next length bits, 0 < length <= 32, call refill first
+  uint32_t peek(size_t length) const {
+    return static_cast<uint32_t>(window >> (64 - length));
+  }
+
+  // @throws std::runtime_error past the end of the input
+  void consume(size_t length) {
+    if (length > available) {
+      throw std::runtime_error("truncated order-1 stream");
+    }
+    window    <<= length;
+    available  -= length;
+  }
+
+  uint32_t read(size_t length) {
+    refill();
+    const uint32_t value = peek(length);
+    consume(length);
+    return value;
+  }
+};
+
+struct clustering {
+  size_t                                clusters;
+  std::array<uint8_t, 256>              cluster_of;    // by previous byte
+  std::array<frequencies, max_clusters> freq;
+  std::array<bit_lengths, max_clusters> lengths;
+  size_t                                bit_size;    // header and message
+};
+
+}    // namespace impl::order1
+
+namespace order1 {
+
+// scratch memory of encode(), reusable across calls
+struct encode_context {
+  std::vector<uint32_t>     pair_freq;    // 256 * previous byte + byte
+  impl::huffman::index_tree tree;
+
+  impl::order1::clustering best;
+  impl::order1::clustering candidate;
+
+  // codes by cluster and byte
+  std::array<std::array<uint16_t, 256>, impl::order1::max_clusters> codes;
+};
+
+// decode tables of decode(), reusable across calls
+struct decode_context {
+  std::vector<uint16_t> tables;    // table_size entries per cluster
+};
+
+}    // namespace order1
+
+namespace impl::order1 {
+
+// lengths of the clusters and the bits of the header after the symbol count
+// and of the message, bytes are the bytes seen
+inline void measure(clustering&                result,
+                    std::span<const uint8_t>   bytes,
+                    impl::huffman::index_tree& tree) {
+  size_t bits = 8 + 256 + result.clusters * bytes.size() * length_bits;
+  if (result.clusters > 1) {
+    bits += 256 * cluster_bits(result.clusters);
+  }
+
+  for (size_t cluster = 0; cluster < result.clusters; ++cluster) {
+    code_lengths(result.freq[cluster], tree, result.lengths[cluster]);
+    for (const uint8_t byte : bytes) {
+      bits += result.freq[cluster][byte] * result.lengths[cluster][byte];
+    }
+  }
+  result.bit_size = bits;
+}
+
+/***
+ * @brief clusters the previous bytes contexts into at most target clusters
+ * @note the first seed is the most frequent context, every next one the
+ * context costing most under its nearest seed. Rounds of assigning each
+ * context to the cluster coding it cheapest and recounting the clusters
+ * follow, clusters left empty are dropped. The cost of a context is the bits
+ * of the bytes following it under the byte distribution of a cluster,
+ * smoothed so bytes it has not seen cost finite bits.
+ * @param pair_freq counts of 256 * previous byte + byte
+ * @param contexts previous bytes seen
+ * @param bytes bytes seen
+ ***/
+inline void cluster(const std::vector<uint32_t>& pair_freq,
+                    std::span<const uint8_t>     contexts,
+                    std::span<const uint8_t>     bytes,
+                    size_t                       target,
+                    clustering&                  result) {
+  constexpr double smoothing = 0.5;
+
+  std::array<std::array<double, 256>, max_clusters> cost;
+
+  const auto row = [&](uint8_t context) {
+    return pair_freq.data() + size_t {context} * 256;
+  };
+
+  const auto update_cost = [&](size_t cluster) {
+    const auto& freq  = result.freq[cluster];
+    double      total = smoothing * static_cast<double>(bytes.size());
+    for (const uint8_t byte : bytes) {
+      total += static_cast<double>(freq[byte]);
+    }
+    for (const uint8_t byte : bytes) {
+      cost[cluster][byte] =
+      std::log2(total / (static_cast<double>(freq[byte]) + smoothing));
+    }
+  };
+
+  const auto context_cost = [&](uint8_t context, size_t cluster) {
+    const uint32_t* freq = row(context);
+    double          bits = 0.0;
+    for (const uint8_t byte : bytes) {
+      bits += freq[byte] * cost[cluster][byte];
+    }
+    return bits;
+  };
+
+  const auto seed = [&](size_t cluster, uint8_t context) {
+    result.freq[cluster].fill(0);
+    std::copy(row(context), row(context) + 256, result.freq[cluster].begin());
+    update_cost(cluster);
+  };
+
+  size_t   heaviest_total = 0;
+  uint8_t  heaviest       = contexts[0];
+  for (const uint8_t context : contexts) {
+    size_t total = 0;
+    for (const uint8_t byte : bytes) {
+      total += row(context)[byte];
+    }
+    if (total > heaviest_total) {
+      heaviest_total = total;
+      heaviest       = context;
+    }
+  }
+
+  result.clusters = std::min(target, contexts.size());
+  seed(0, heaviest);
+
+  std::array<double, 256> nearest;
+  for (const uint8_t context : contexts) {
+    nearest[context] = context_cost(context, 0);
+  }
+  for (size_t cluster = 1; cluster < result.clusters; ++cluster) {
+    const uint8_t farthest = *std::max_element(
+    contexts.begin(), contexts.end(), [&](uint8_t lhs, uint8_t rhs) {
+      return nearest[lhs] < nearest[rhs];
+    });
+    seed(cluster, farthest);
+    for (const uint8_t context : contexts) {
+      nearest[context] =
+      std::min(nearest[context], context_cost(context, cluster));
+    }
+  }
+
+  result.cluster_of.fill(0);
+  for (size_t round = 0; round < cluster_rounds; ++round) {
+    for (const uint8_t context : contexts) {
+      size_t cheapest      = 0;
+      double cheapest_cost = context_cost(context, 0);
+      for (size_t cluster = 1; cluster < result.clusters; ++cluster) {
+        const double bits = context_cost(context, cluster);
+        if (bits < cheapest_cost) {
+          cheapest      = cluster;
+          cheapest_cost = bits;
+        }
+      }
+      result.cluster_of[context] = static_cast<uint8_t>(cheapest);
+    }
+
+    // recount, clusters numbered again without the empty ones
+    std::array<uint8_t, max_clusters> renumbered;
+    std::array<bool, max_clusters>    used {};
+    for (const uint8_t context : contexts) {
+      used[result.cluster_of[context]] = true;
+    }
+    size_t clusters = 0;
+    for (size_t cluster = 0; cluster < result.clusters; ++cluster) {
+      if (used[cluster]) {
+        renumbered[cluster] = static_cast<uint8_t>(clusters++);
+      }
+    }
+    result.clusters = clusters;
+
+    for (size_t cluster = 0; cluster < clusters; ++cluster) {
+      result.freq[cluster].fill(0);
+    }
+    for (const uint8_t context : contexts) {
+      auto& cluster = result.cluster_of[context];
+      cluster       = renumbered[cluster];
+      for (const uint8_t byte : bytes) {
+        result.freq[cluster][byte] += row(context)[byte];
+      }
+    }
+    for (size_t cluster = 0; cluster < clusters; ++cluster) {
+      update_cost(cluster);
+    }
+  }
+}
+
+inline void record_output(const clustering&        result,
+                          std::span<const uint8_t> bytes,
+                          size_t                   header_bytes) {
+  impl::stats::record([&](::stats::counters& stats) {
+    for (size_t cluster = 0; cluster < result.clusters; ++cluster) {
+      for (const uint8_t byte : bytes) {
+        const uint8_t length = result.lengths[cluster][byte];
+        if (result.freq[cluster][byte] != 0) {
+          ++stats.code_lengths[length];
+          stats.max_tree_depth =
+          std::max<uint64_t>(stats.max_tree_depth, length);
+        }
+      }
+    }
+    stats.compress_bytes_out += header_bytes + (result.bit_size + 7) / 8;
+  });
+}
+
+}    // namespace impl::order1
+
+namespace order1 {
+
+// Output format:
+// (varint) byte count -> [bytes: (8 bits) cluster count
+// -> [clusters > 1: (cluster_bits per previous byte) its cluster]
+// -> (256 bits) bytes seen -> per cluster, per byte seen (4 bits) code length
+// -> (bits) msg -> (bits) pad to byte]
+// the first byte is coded with the cluster of previous byte 0
+
+/***
+ * @brief encode with a Huffman table per cluster of previous bytes
+ * @note cluster counts double from 1 while the output shrinks, up to
+ * max_clusters, so data without order-1 structure stops at 1 after one try
+ ***/
+template<typename ItrIn, typename ItrOut>
+requires std::forward_iterator<ItrIn> &&
+         std::output_iterator<ItrOut, uint8_t>
+void encode(ItrIn begin, ItrIn end, ItrOut out, encode_context& context) {
+  impl::stats::stage_timer tree_timer {&stats::counters::huffman_tree};
+
+  auto& pair_freq = context.pair_freq;
+  pair_freq.assign(256 * 256, 0);
+
+  size_t  count    = 0;
+  uint8_t previous = 0;
+  for (auto itr = begin; itr != end; ++itr) {
+    const uint8_t byte = *itr;
+    ++pair_freq[size_t {previous} * 256 + byte];
+    previous = byte;
+    ++count;
+  }
+
+  std::array<uint8_t, 16> count_scratch;
+  const auto              count_end =
+  util::write_varint(count_scratch.begin(), count);
+  for (auto itr = count_scratch.begin(); itr != count_end; ++itr) {
+    *out++ = *itr;
+  }
+  if (count == 0) {
+    return;
+  }
+
+  std::array<bool, 256> seen_context {};
+  std::array<bool, 256> seen_byte {};
+  for (size_t pair = 0; pair < pair_freq.size(); ++pair) {
+    if (pair_freq[pair] != 0) {
+      seen_context[pair / 256] = true;
+      seen_byte[pair % 256]    = true;
+    }
+  }
+
+  std::array<uint8_t, 256> contexts_seen;
+  std::array<uint8_t, 256> bytes_seen;
+  size_t                   context_count = 0;
+  size_t                   byte_count    = 0;
+  for (size_t byte = 0; byte < 256; ++byte) {
+    if (seen_context[byte]) {
+      contexts_seen[context_count++] = static_cast<uint8_t>(byte);
+    }
+    if (seen_byte[byte]) {
+      bytes_seen[byte_count++] = static_cast<uint8_t>(byte);
+    }
+  }
+  const std::span<const uint8_t> contexts {contexts_seen.data(),
+                                           context_count};
+  const std::span<const uint8_t> bytes {bytes_seen.data(), byte_count};
+
+  // one cluster, order-0 statistics in the order-1 format
+  auto& best = context.best;
+  best.clusters = 1;
+  best.cluster_of.fill(0);
+  best.freq[0].fill(0);
+  for (size_t pair = 0; pair < pair_freq.size(); ++pair) {
+    best.freq[0][pair % 256] += pair_freq[pair];
+  }
+  impl::order1::measure(best, bytes, context.tree);
+
+  auto& candidate = context.candidate;
+  for (size_t target = 2; target <= impl::order1::max_clusters; target *= 2) {
+    if (target > contexts.size()) {
+      break;
+    }
+    impl::order1::cluster(pair_freq, contexts, bytes, target, candidate);
+    impl::order1::measure(candidate, bytes, context.tree);
+
+    // more clusters rarely help when these did not
+    if (candidate.bit_size >= best.bit_size) {
+      break;
+    }
+    std::swap(best, candidate);
+  }
+
+  for (size_t cluster = 0; cluster < best.clusters; ++cluster) {
+    impl::order1::canonical_codes(best.lengths[cluster],
+                                  context.codes[cluster]);
+  }
+
+  impl::order1::record_output(best,
+                              bytes,
+                              static_cast<size_t>(count_end -
+                                                  count_scratch.begin()));
+
+  tree_timer.stop();
+  impl::stats::stage_timer output_timer {&stats::counters::huffman_output};
+
+  impl::order1::bit_packer packer {out};
+
+  packer.write(static_cast<uint32_t>(best.clusters), 8);
+  if (best.clusters > 1) {
+    const size_t bits = impl::order1::cluster_bits(best.clusters);
+    for (const uint8_t cluster : best.cluster_of) {
+      packer.write(cluster, bits);
+    }
+  }
+
+  for (const bool seen : seen_byte) {
+    packer.write(seen ? 1 : 0, 1);
+  }
+  for (size_t cluster = 0; cluster < best.clusters; ++cluster) {
+    for (const uint8_t byte : bytes) {
+      packer.write(best.lengths[cluster][byte], impl::order1::length_bits);
+    }
+  }
+
+  previous = 0;
+  for (auto itr = begin; itr != end; ++itr) {
+    const uint8_t byte    = *itr;
+    const uint8_t cluster = best.cluster_of[previous];
+    packer.write(context.codes[cluster][byte], best.lengths[cluster][byte]);
+    previous = byte;
+  }
+
+  packer.flush();
+}
+
+template<typename ItrIn, typename ItrOut>
+requires std::forward_iterator<ItrIn> &&
+         std::output_iterator<ItrOut, uint8_t>
+void encode(ItrIn begin, ItrIn end, ItrOut out) {
+  encode_context context;
+  encode(begin, end, out, context);
+}
+
+/***
+ * @brief decode of the first limit bytes only, decoding stops after them
+ * @throws std::runtime_error on malformed input
+ ***/
+template<typename ItrIn, typename ItrOut>
+requires std::random_access_iterator<ItrIn> &&
+         std::output_iterator<ItrOut, uint8_t>
+void decode(ItrIn           begin,
+            ItrIn           end,
+            ItrOut          out,
+            decode_context& context,
+            size_t          limit) {
+  impl::stats::stage_timer timer {&stats::counters::huffman_decode};
+
+  using impl::order1::table_size;
+
+  auto           itr   = begin;
+  const uint64_t count = util::read_varint(itr, end);
+  if (count == 0) {
+    return;
+  }
+
+  impl::order1::bit_unpacker reader {itr, end};
+
+  const size_t clusters = reader.read(8);
+  if (clusters == 0 || clusters > impl::order1::max_clusters) {
+    throw std::runtime_error("invalid cluster count");
+  }
+
+  // table offset by previous byte
+  std::array<uint32_t, 256> table_of {};
+  if (clusters > 1) {
+    const size_t bits = impl::order1::cluster_bits(clusters);
+    for (auto& offset : table_of) {
+      const uint32_t cluster = reader.read(bits);
+      if (cluster >= clusters) {
+        throw std::runtime_error("invalid cluster");
+      }
+      offset = static_cast<uint32_t>(cluster * table_size);
+    }
+  }
+
+  std::array<uint8_t, 256> bytes;
+  size_t                   byte_count = 0;
+  for (size_t byte = 0; byte < 256; ++byte) {
+    if (reader.read(1) != 0) {
+      bytes[byte_count++] = static_cast<uint8_t>(byte);
+    }
+  }
+
+  auto& tables = context.tables;
+  tables.resize(clusters * table_size);
+  for (size_t cluster = 0; cluster < clusters; ++cluster) {
+    impl::order1::bit_lengths lengths {};
+    for (size_t idx = 0; idx < byte_count; ++idx) {
+      lengths[bytes[idx]] =
+      static_cast<uint8_t>(reader.read(impl::order1::length_bits));
+    }
+    impl::order1::build_decode_table(lengths,
+                                     tables.data() + cluster * table_size);
+  }
+
+  const size_t symbols  = std::min<uint64_t>(count, limit);
+  uint8_t      previous = 0;
+  for (size_t idx = 0; idx < symbols; ++idx) {
+    reader.refill();
+    const uint16_t entry =
+    tables[table_of[previous] + reader.peek(impl::order1::max_code_length)];
+
+    const size_t length = entry >> 8;
+    if (length == 0) {
+      throw std::runtime_error("invalid code");
+    }
+    reader.consume(length);
+
+    previous = static_cast<uint8_t>(entry);
+    *out++   = previous;
+  }
+}
+
+template<typename ItrIn, typename ItrOut>
+requires std::random_access_iterator<ItrIn> &&
+         std::output_iterator<ItrOut, uint8_t>
+void decode(ItrIn begin, ItrIn end, ItrOut out, decode_context& context) {
+  decode(begin, end, out, context, std::numeric_limits<size_t>::max());
+}
+
+template<typename ItrIn, typename ItrOut>
+requires std::random_access_iterator<ItrIn> &&
+         std::output_iterator<ItrOut, uint8_t>
+void decode(ItrIn begin, ItrIn end, ItrOut out) {
+  decode_context context;
+  decode(begin, end, out, context);
+}
+
+}    // namespace order1
@@ -0,0 +1,391 @@
+#pragma once
+
+#include "COMPRESS.hpp"
+#include "STATS.hpp"
+#include "UTIL.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+// Optimal parsing: sections of several sizes, chosen per region by dynamic
+// programming over an estimate of their coded bits, so sections follow the
+// structure of the input instead of cutting records at fixed offsets. The
+// estimates step every candidate section, which makes compression tens of
+// times slower than the fixed section size of compress(), which stays the
+// default.
+//
+// Format: as compress(), with the count byte before each section replaced by
+// size index * (run_count + 1) + count, so the chosen sizes are entropy coded
+// along with the counts. The last section may be cut short by the end.
+
+namespace impl::parse {
+
+// values of a count, runs included, the symbol of a section is size_index *
+// count_values + count
+constexpr size_t count_values = impl::compress::run_count + 1;
+
+// section sizes a symbol can tell apart
+constexpr size_t max_sizes = 256 / count_values;
+
+constexpr uint8_t symbol(size_t size_index, uint8_t count) {
+  return static_cast<uint8_t>(size_index * count_values + count);
+}
+
+// @throws std::invalid_argument unless 1 to max_sizes sizes, all transformable
+inline void check_sizes(std::span<const size_t> section_sizes) {
+  if (section_sizes.empty() || section_sizes.size() > max_sizes) {
+    throw std::invalid_argument("parse takes 1 to 7 section sizes");
+  }
+  for (const size_t size : section_sizes) {
+    if (!impl::compress::transformable(static_cast<ptrdiff_t>(size))) {
+      throw std::invalid_argument("section sizes must be even and at least 4");
+    }
+  }
+}
+
+/***
+ * @brief the section is woven as its run symbol and byte only, see
+ * impl::compress::run_count
+ * @note as in compress(), only full sections of a single byte of sizes above
+ * 2 are, and only with context.run_tokens
+ ***/
+inline bool run(const compression_context& context,
+                size_t                     section_size,
+                impl::compress::data_itr   begin,
+                impl::compress::data_itr   end) {
+  return context.run_tokens && section_size > 2 &&
+         static_cast<size_t>(std::distance(begin, end)) == section_size &&
+         impl::compress::uniform(begin, end);
+}
+
+// bits of every byte under the order-0 code of histogram, absent bytes cost
+// a bit more than the rarest present one could
+inline std::array<double, 256> code_lengths(const util::histogram& histogram) {
+  const double total =
+  std::log2(static_cast<double>(std::max<size_t>(histogram.size(), 1)));
+
+  std::array<double, 256> lengths;
+  for (size_t byte = 0; byte < 256; ++byte) {
+    const size_t freq = histogram[static_cast<uint8_t>(byte)];
+    lengths[byte] =
+    freq == 0 ? total + 1.0 : total - std::log2(static_cast<double>(freq));
+  }
+  return lengths;
+}
+
+/***
+ * @brief estimated bits of a section and its symbol at its best count
+ * @note every count up to depth is stepped on scratch and priced with
+ * lengths, plus penalty bits per generation. A step changes one half only,
+ * only that half is priced again.
+ ***/
+inline double estimate(const std::array<double, 256>& lengths,
+                       uint8_t                        rule,
+                       impl::compress::data_itr       begin,
+                       impl::compress::data_itr       end,
+                       size_t                         size_index,
+                       uint8_t                        depth,
+                       double                         penalty,
+                       std::vector<uint8_t>&          scratch) {
+  const auto bits = [&](auto first, auto last) {
+    double sum = 0.0;
+    for (auto itr = first; itr != last; ++itr) {
+      sum += lengths[*itr];
+    }
+    return sum;
+  };
+
+  const auto size = std::distance(begin, end);
+  double     best = bits(begin, end) + lengths[symbol(size_index, 0)];
+
+  if (!impl::compress::transformable(size) ||
+      impl::compress::fixed_uniform(rule, begin, end)) {
+    return best;
+  }
+
+  scratch.assign(begin, end);
+  const auto middle = scratch.begin() + size / 2;
+
+  double front_bits = bits(scratch.begin(), middle);
+  double back_bits  = bits(middle, scratch.end());
+
+  const impl::compress::dynamic_rule stepper {.rule = rule};
+  for (uint8_t count = 1; count <= depth; ++count) {
+    stepper.forward(scratch.begin(), scratch.end(), count);
+    if (count % 2 == 1) {
+      front_bits = bits(scratch.begin(), middle);
+    } else {
+      back_bits = bits(middle, scratch.end());
+    }
+
+    best = std::min(best,
+                    front_bits + back_bits +
+                    lengths[symbol(size_index, count)] + penalty * count);
+  }
+
+  return best;
+}
+
+/***
+ * @brief size index of every section of the cheapest parse of context.data
+ * into context.parse_sizes
+ * @note sections start at multiples of the gcd of the sizes. The parse is
+ * solved from the end: the bits from a position to the end are the least,
+ * over the sizes, of a section there plus the bits from where it ends.
+ ***/
+inline void choose(std::span<const size_t> section_sizes,
+                   uint8_t                 rule,
+                   uint8_t                 depth,
+                   const util::histogram&  histogram,
+                   compression_context&    context) {
+  const auto lengths = code_lengths(histogram);
+
+  const size_t grain =
+  std::accumulate(section_sizes.begin(),
+                  section_sizes.end(),
+                  size_t {0},
+                  [](size_t lhs, size_t rhs) { return std::gcd(lhs, rhs); });
+
+  auto&        data      = context.data;
+  const size_t size      = data.size();
+  const size_t positions = (size + grain - 1) / grain;
+
+  auto& costs = context.parse_costs;
+  auto& sizes = context.parse_sizes;
+  costs.assign(positions + 1, 0.0);
+  sizes.assign(positions, 0);
+
+  for (size_t position = positions; position-- > 0;) {
+    const size_t start = position * grain;
+
+    costs[position] = std::numeric_limits<double>::infinity();
+    for (size_t idx = 0; idx < section_sizes.size(); ++idx) {
+      const size_t length = std::min(section_sizes[idx], size - start);
+      const size_t next =
+      std::min(positions, position + section_sizes[idx] / grain);
+
+      const auto section_begin = data.begin() + start;
+      const auto section_end   = section_begin + length;
+
+      const double bits =
+      run(context, section_sizes[idx], section_begin, section_end)
+      ? lengths[*section_begin] +
+        lengths[symbol(idx, impl::compress::run_count)]
+      : estimate(lengths,
+                 rule,
+                 section_begin,
+                 section_end,
+                 idx,
+                 depth,
+                 context.generation_penalty,
+                 context.woven);
+      const double cost = bits + costs[next];
+      if (cost < costs[position]) {
+        costs[position] = cost;
+        sizes[position] = static_cast<uint8_t>(idx);
+      }
+    }
+  }
+
+  // the sections of the parse, from the front
+  size_t section = 0;
+  for (size_t position = 0; position < positions;
+       position += section_sizes[sizes[position]] / grain) {
+    sizes[section++] = sizes[position];
+  }
+  sizes.resize(section);
+}
+
+}    // namespace impl::parse
+
+namespace parse {
+
+/***
+ * @brief compress with section sizes chosen per region among section_sizes
+ * @note decompress with parse::decompress and the same rule and sizes.
+ * Compression settings of the context apply as in compress(), shuffle, run
+ * tokens and input histogram included; the memo, penalty and budget also
+ * shape the search of the chosen sections.
+ * @throws std::invalid_argument for 0 or more than impl::parse::max_sizes
+ * sizes, a size that is odd or below 4, or depth above
+ * impl::compress::max_count
+ ***/
+template<typename ItrIn, typename ItrOut>
+void compress(ItrIn                   begin,
+              ItrIn                   end,
+              ItrOut                  out,
+              compression_context&    context,
+              uint8_t                 rule,
+              std::span<const size_t> section_sizes =
+              impl::compress::dispatch_section_sizes,
+              uint8_t depth = impl::compress::max_count) {
+  impl::parse::check_sizes(section_sizes);
+  if (depth > impl::compress::max_count) {
+    throw std::invalid_argument("depth must not exceed max_count");
+  }
+  if (begin == end) {
+    context.input_histogram.reset();
+    return;
+  }
+  if (context.model == entropy_model::dictionary &&
+      context.dictionary == nullptr) {
+    throw std::invalid_argument("dictionary model without a table");
+  }
+
+  auto& data = context.data;
+  data.assign(begin, end);
+
+  impl::compress::shuffle_data(context);
+  util::histogram histogram = impl::compress::input_histogram_of(context);
+
+  impl::parse::choose(section_sizes, rule, depth, histogram, context);
+
+  auto& woven       = context.woven;
+  auto& soca_counts = context.soca_counts;
+  woven.clear();
+  soca_counts.clear();
+
+  size_t budget = context.generation_budget;
+  size_t start  = 0;
+  for (const uint8_t size_index : context.parse_sizes) {
+    impl::stats::stage_timer timer {&::stats::counters::search};
+
+    const size_t section_size  = section_sizes[size_index];
+    const auto   section_begin = data.begin() + start;
+    const auto   section_end =
+    section_begin + std::min(section_size, data.size() - start);
+
+    if (impl::parse::run(context, section_size, section_begin, section_end)) {
+      const uint8_t symbol =
+      impl::parse::symbol(size_index, impl::compress::run_count);
+      histogram.decrement(*section_begin, section_size - 1);
+      histogram.increment(symbol);
+
+      soca_counts.push_back(impl::compress::run_count);
+      woven.push_back(symbol);
+      woven.push_back(*section_begin);
+      start += section_size;
+      continue;
+    }
+
+    uint8_t count = 0;
+    impl::compress::with_kernels(rule, section_size, [&](auto kernels) {
+      count = impl::compress::search_section(histogram,
+                                             section_begin,
+                                             section_end,
+                                             kernels,
+                                             depth,
+                                             context,
+                                             budget);
+    });
+
+    // the search accounts the count, the stream holds the symbol
+    const uint8_t symbol = impl::parse::symbol(size_index, count);
+    histogram.decrement(count);
+    histogram.increment(symbol);
+
+    soca_counts.push_back(count);
+    woven.push_back(symbol);
+    woven.insert(woven.end(), section_begin, section_end);
+    start += std::distance(section_begin, section_end);
+  }
+
+  impl::stats::record([&](::stats::counters& stats) {
+    stats.compress_bytes_in += data.size();
+    stats.sections          += soca_counts.size();
+    for (const uint8_t count : soca_counts) {
+      ++stats.chosen_counts[count];
+    }
+  });
+
+  impl::compress::encode_woven(
+  woven.begin(), woven.end(), out, histogram, context);
+}
+
+/***
+ * @brief decompress output of parse::compress
+ * @note the shuffle of the context must be that of the compression
+ * @throws std::invalid_argument for section sizes parse::compress rejects
+ * @throws std::runtime_error for a symbol naming no section size or a run
+ * without its byte
+ ***/
+template<typename ItrIn, typename ItrOut>
+void decompress(ItrIn                   begin,
+                ItrIn                   end,
+                ItrOut                  out,
+                decompression_context&  context,
+                uint8_t                 rule,
+                std::span<const size_t> section_sizes =
+                impl::compress::dispatch_section_sizes) {
+  impl::parse::check_sizes(section_sizes);
+  if (begin == end) {
+    return;
+  }
+
+  auto& woven = context.woven;
+  woven.clear();
+  impl::compress::decode_woven(begin,
+                               end,
+                               std::back_inserter(woven),
+                               context,
+                               std::numeric_limits<size_t>::max());
+
+  auto& sections = context.sections;
+  sections.clear();
+  sections.reserve(woven.size());
+
+  for (size_t idx = 0; idx < woven.size();) {
+    impl::stats::stage_timer timer {&::stats::counters::reverse};
+
+    const uint8_t symbol     = woven[idx++];
+    const size_t  size_index = symbol / impl::parse::count_values;
+    const auto    count =
+    static_cast<uint8_t>(symbol % impl::parse::count_values);
+    if (size_index >= section_sizes.size()) {
+      throw std::runtime_error("invalid section symbol");
+    }
+
+    const size_t section_size = section_sizes[size_index];
+    if (count == impl::compress::run_count) {
+      if (idx == woven.size()) {
+        throw std::runtime_error("truncated run");
+      }
+      sections.insert(sections.end(), section_size, woven[idx++]);
+      continue;
+    }
+
+    const size_t length = std::min(section_size, woven.size() - idx);
+    const auto   section_begin =
+    sections.insert(sections.end(),
+                    woven.begin() + static_cast<ptrdiff_t>(idx),
+                    woven.begin() + static_cast<ptrdiff_t>(idx + length));
+    const auto section_end = sections.end();
+
+    if (count != 0 &&
+        !impl::compress::fixed_uniform(rule, section_begin, section_end)) {
+      impl::compress::with_kernels(rule, section_size, [&](auto kernels) {
+        kernels.reverse(section_begin, section_end, count);
+      });
+    }
+    idx += length;
+  }
+
+  impl::stats::record([&](::stats::counters& stats) {
+    stats.decompress_bytes_in  += std::distance(begin, end);
+    stats.decompress_bytes_out += sections.size();
+  });
+
+  const auto& result = impl::compress::unshuffled(context);
+  std::copy(result.begin(), result.end(), out);
+}
+
+}    // namespace parse
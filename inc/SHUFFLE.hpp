@@ -0,0 +1,301 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+
+// Byte and bit shuffles of fixed width elements, ahead of the SOCA search.
+// SOCA sees a byte as 8 adjacent cells, in arrays of numbers the bits of
+// equal significance, which correlate, sit a whole element apart. Shuffles
+// group them: byte shuffle puts byte j of every element into plane j, bit
+// shuffle further splits every plane into its 8 bit planes.
+// Bytes after the last whole element, or the last whole group of 8 elements
+// for bit shuffle, are copied as they are.
+
+namespace shuffle {
+
+enum class mode : uint8_t {
+  none  = 0,
+  bytes = 1,
+  bits  = 2,
+};
+
+}    // namespace shuffle
+
+namespace impl::shuffle {
+
+// @throws std::invalid_argument for width 0 or sizes that differ
+inline void check(std::span<const uint8_t> in,
+                  std::span<uint8_t>       out,
+                  size_t                   width) {
+  if (width == 0) {
+    throw std::invalid_argument("element width must be positive");
+  }
+  if (in.size() != out.size()) {
+    throw std::invalid_argument("shuffle output size must equal input size");
+  }
+}
+
+/***
+ * @brief transposes the 8x8 bit matrix of rows x, row 0 in the high byte
+ * @note its own inverse, swaps 1x1, 2x2 then 4x4 blocks across the diagonal
+ ***/
+constexpr uint64_t transpose(uint64_t x) {
+  uint64_t t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+  x          = x ^ t ^ (t << 7);
+  t          = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+  x          = x ^ t ^ (t << 14);
+  t          = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+  return x ^ t ^ (t << 28);
+}
+
+#if defined(__SSE2__)
+// lanes of 2 groups of 8 with element i of a group in lane 7 - i of its half,
+// so movemask puts element 0 in the high bit of a plane byte
+inline __m128i reverse_halves(__m128i lanes) {
+  lanes = _mm_shufflelo_epi16(lanes, _MM_SHUFFLE(0, 1, 2, 3));
+  lanes = _mm_shufflehi_epi16(lanes, _MM_SHUFFLE(0, 1, 2, 3));
+  return _mm_or_si128(_mm_slli_epi16(lanes, 8), _mm_srli_epi16(lanes, 8));
+}
+
+/***
+ * @brief 8x8 bit transposes of the 2 halves of lanes, most significant bit
+ * first: row i of the first half goes to out[i * stride], of the second to
+ * out[i * stride + half]
+ * @note movemask gathers the high bit of every lane, adding lanes to
+ * themselves moves the next bit up
+ ***/
+inline void transpose_pair(__m128i  lanes,
+                           uint8_t* out,
+                           size_t   stride,
+                           size_t   half) {
+  for (size_t row = 0; row < 8; ++row) {
+    const auto mask          = static_cast<uint32_t>(_mm_movemask_epi8(lanes));
+    out[row * stride]        = static_cast<uint8_t>(mask);
+    out[row * stride + half] = static_cast<uint8_t>(mask >> 8);
+    lanes                    = _mm_add_epi8(lanes, lanes);
+  }
+}
+
+// lanes of in[i * stride] and in[i * stride + half], i < 8, in the order of
+// reverse_halves
+inline __m128i gather_pair(const uint8_t* in, size_t stride, size_t half) {
+  alignas(16) uint8_t lanes[16];
+  for (size_t idx = 0; idx < 8; ++idx) {
+    lanes[7 - idx]  = in[idx * stride];
+    lanes[15 - idx] = in[idx * stride + half];
+  }
+  return _mm_load_si128(reinterpret_cast<const __m128i*>(lanes));
+}
+#endif
+
+// one pass over the elements writing all planes, width fixed at compile time
+// for the common widths so the inner loop unrolls
+template<size_t width>
+void shuffle_fixed(const uint8_t* in, uint8_t* out, size_t elements) {
+  for (size_t element = 0; element < elements; ++element) {
+    for (size_t byte = 0; byte < width; ++byte) {
+      out[byte * elements + element] = in[element * width + byte];
+    }
+  }
+}
+
+template<size_t width>
+void unshuffle_fixed(const uint8_t* in, uint8_t* out, size_t elements) {
+  for (size_t element = 0; element < elements; ++element) {
+    for (size_t byte = 0; byte < width; ++byte) {
+      out[element * width + byte] = in[byte * elements + element];
+    }
+  }
+}
+
+}    // namespace impl::shuffle
+
+namespace shuffle {
+
+// out[j * elements + i] = in[i * width + j]
+inline void shuffle_bytes(std::span<const uint8_t> in,
+                          std::span<uint8_t>       out,
+                          size_t                   width) {
+  impl::shuffle::check(in, out, width);
+
+  const size_t elements = in.size() / width;
+  switch (width) {
+    case 2:
+      impl::shuffle::shuffle_fixed<2>(in.data(), out.data(), elements);
+      break;
+    case 4:
+      impl::shuffle::shuffle_fixed<4>(in.data(), out.data(), elements);
+      break;
+    case 8:
+      impl::shuffle::shuffle_fixed<8>(in.data(), out.data(), elements);
+      break;
+    default:
+      for (size_t byte = 0; byte < width; ++byte) {
+        uint8_t* plane = out.data() + byte * elements;
+        for (size_t element = 0; element < elements; ++element) {
+          plane[element] = in[element * width + byte];
+        }
+      }
+  }
+
+  const size_t shuffled = elements * width;
+  std::copy(in.begin() + shuffled, in.end(), out.begin() + shuffled);
+}
+
+inline void unshuffle_bytes(std::span<const uint8_t> in,
+                            std::span<uint8_t>       out,
+                            size_t                   width) {
+  impl::shuffle::check(in, out, width);
+
+  const size_t elements = in.size() / width;
+  switch (width) {
+    case 2:
+      impl::shuffle::unshuffle_fixed<2>(in.data(), out.data(), elements);
+      break;
+    case 4:
+      impl::shuffle::unshuffle_fixed<4>(in.data(), out.data(), elements);
+      break;
+    case 8:
+      impl::shuffle::unshuffle_fixed<8>(in.data(), out.data(), elements);
+      break;
+    default:
+      for (size_t byte = 0; byte < width; ++byte) {
+        const uint8_t* plane = in.data() + byte * elements;
+        for (size_t element = 0; element < elements; ++element) {
+          out[element * width + byte] = plane[element];
+        }
+      }
+  }
+
+  const size_t shuffled = elements * width;
+  std::copy(in.begin() + shuffled, in.end(), out.begin() + shuffled);
+}
+
+/***
+ * @brief bit planes of the elements, most significant byte plane bit first
+ * @note bit plane (byte * 8 + bit) holds that bit of every element, 8
+ * elements per output byte. Groups of 8 elements are transposed as one 8x8
+ * bit matrix in a 64 bit word, with SSE2 pairs of groups as 16 lanes.
+ ***/
+inline void shuffle_bits(std::span<const uint8_t> in,
+                         std::span<uint8_t>       out,
+                         size_t                   width) {
+  impl::shuffle::check(in, out, width);
+
+  const size_t groups = in.size() / width / 8;
+  for (size_t byte = 0; byte < width; ++byte) {
+    uint8_t* planes = out.data() + byte * 8 * groups;
+    size_t   group  = 0;
+#if defined(__SSE2__)
+    for (; group + 2 <= groups; group += 2) {
+      const uint8_t* elements = in.data() + group * 8 * width + byte;
+      const __m128i  lanes =
+      width == 1 ? impl::shuffle::reverse_halves(_mm_loadu_si128(
+                   reinterpret_cast<const __m128i*>(elements)))
+                 : impl::shuffle::gather_pair(elements, width, 8 * width);
+      impl::shuffle::transpose_pair(lanes, planes + group, groups, 1);
+    }
+#endif
+    for (; group < groups; ++group) {
+      const uint8_t* elements = in.data() + group * 8 * width + byte;
+
+      uint64_t rows = 0;
+      for (size_t row = 0; row < 8; ++row) {
+        rows = rows << 8 | elements[row * width];
+      }
+      rows = impl::shuffle::transpose(rows);
+
+      for (size_t bit = 0; bit < 8; ++bit) {
+        planes[bit * groups + group] =
+        static_cast<uint8_t>(rows >> (56 - 8 * bit));
+      }
+    }
+  }
+
+  const size_t shuffled = groups * 8 * width;
+  std::copy(in.begin() + shuffled, in.end(), out.begin() + shuffled);
+}
+
+inline void unshuffle_bits(std::span<const uint8_t> in,
+                           std::span<uint8_t>       out,
+                           size_t                   width) {
+  impl::shuffle::check(in, out, width);
+
+  const size_t groups = in.size() / width / 8;
+  for (size_t byte = 0; byte < width; ++byte) {
+    const uint8_t* planes = in.data() + byte * 8 * groups;
+    size_t         group  = 0;
+#if defined(__SSE2__)
+    for (; group + 2 <= groups; group += 2) {
+      const __m128i lanes =
+      impl::shuffle::gather_pair(planes + group, groups, 1);
+      uint8_t* elements = out.data() + group * 8 * width + byte;
+      impl::shuffle::transpose_pair(lanes, elements, width, 8 * width);
+    }
+#endif
+    for (; group < groups; ++group) {
+      uint64_t rows = 0;
+      for (size_t bit = 0; bit < 8; ++bit) {
+        rows = rows << 8 | planes[bit * groups + group];
+      }
+      rows = impl::shuffle::transpose(rows);
+
+      uint8_t* elements = out.data() + group * 8 * width + byte;
+      for (size_t row = 0; row < 8; ++row) {
+        elements[row * width] = static_cast<uint8_t>(rows >> (56 - 8 * row));
+      }
+    }
+  }
+
+  const size_t shuffled = groups * 8 * width;
+  std::copy(in.begin() + shuffled, in.end(), out.begin() + shuffled);
+}
+
+// shuffle of the mode, mode::none copies
+inline void apply(mode                     shuffle,
+                  std::span<const uint8_t> in,
+                  std::span<uint8_t>       out,
+                  size_t                   width) {
+  switch (shuffle) {
+    case mode::none:
+      impl::shuffle::check(in, out, width);
+      std::copy(in.begin(), in.end(), out.begin());
+      return;
+    case mode::bytes:
+      shuffle_bytes(in, out, width);
+      return;
+    case mode::bits:
+      shuffle_bits(in, out, width);
+      return;
+  }
+  throw std::invalid_argument("unknown shuffle mode");
+}
+
+// inverse of apply
+inline void revert(mode                     shuffle,
+                   std::span<const uint8_t> in,
+                   std::span<uint8_t>       out,
+                   size_t                   width) {
+  switch (shuffle) {
+    case mode::none:
+      impl::shuffle::check(in, out, width);
+      std::copy(in.begin(), in.end(), out.begin());
+      return;
+    case mode::bytes:
+      unshuffle_bytes(in, out, width);
+      return;
+    case mode::bits:
+      unshuffle_bits(in, out, width);
+      return;
+  }
+  throw std::invalid_argument("unknown shuffle mode");
+}
+
+}    // namespace shuffle
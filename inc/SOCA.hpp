@@ -2,9 +2,128 @@
 
 #include <type_traits>
 #include <iterator>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <utility>
 #include <cstddef>
 #include <cstdint>
 
+// jumps are compiled for the carry-less multiply instruction whatever the
+// target and taken where the cpu has it, see soca::fast_jump
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+  #include <wmmintrin.h>
+  #define CACOMPRESS_PCLMUL __attribute__((target("pclmul")))
+#endif
+
+namespace impl::soca {
+
+// neighbourhood pattern (left, center, right) of 64 cells at once
+template<uint8_t pattern>
+constexpr uint64_t minterm(uint64_t left, uint64_t center, uint64_t right) {
+  return ((pattern & 0b100) != 0 ? left : ~left) &
+         ((pattern & 0b010) != 0 ? center : ~center) &
+         ((pattern & 0b001) != 0 ? right : ~right);
+}
+
+// rule applied to 64 cells at once, bit i of left/center/right is the
+// neighbourhood of cell i
+template<uint8_t rule>
+constexpr uint64_t apply(uint64_t left, uint64_t center, uint64_t right) {
+  return [&]<uint8_t... pattern>(
+         std::integer_sequence<uint8_t, pattern...> /*unused*/) {
+    return ((((rule >> pattern) & 1) != 0
+             ? minterm<pattern>(left, center, right)
+             : uint64_t {0}) |
+            ...);
+  }(std::make_integer_sequence<uint8_t, 8> {});
+}
+
+constexpr uint64_t apply(uint8_t  rule,
+                         uint64_t left,
+                         uint64_t center,
+                         uint64_t right) {
+  return [&]<uint8_t... pattern>(
+         std::integer_sequence<uint8_t, pattern...> /*unused*/) {
+    return ((-static_cast<uint64_t>((rule >> pattern) & 1) &
+             minterm<pattern>(left, center, right)) |
+            ...);
+  }(std::make_integer_sequence<uint8_t, 8> {});
+}
+
+/***
+ * @brief cells of one half of a section packed into 64 bit words
+ * Cell order follows the byte kernels: byte 0 bit 7 is cell 0, the half
+ * wraps around. Cells are stored MSB first, so cell 0 is bit 63 of word 0
+ * and the unused low bits of the last word stay 0.
+ ***/
+template<size_t half_size>
+class packed_half {
+  static constexpr size_t cells      = half_size * 8;
+  static constexpr size_t words      = (cells + 63) / 64;
+  static constexpr size_t tail_cells = cells - 64 * (words - 1);
+
+  static constexpr uint64_t tail_mask =
+  tail_cells == 64 ? ~uint64_t {0} : ~(~uint64_t {0} >> tail_cells);
+
+  std::array<uint64_t, words> word {};
+
+public:
+  template<typename Itr>
+  constexpr void load(Itr begin) {
+    word = {};
+    for (size_t idx = 0; idx < half_size; ++idx, ++begin) {
+      word[idx / 8] |= static_cast<uint64_t>(*begin) << (56 - 8 * (idx % 8));
+    }
+  }
+
+  template<typename Itr>
+  constexpr void store(Itr begin) const {
+    for (size_t idx = 0; idx < half_size; ++idx, ++begin) {
+      *begin = byte(idx);
+    }
+  }
+
+  constexpr uint8_t byte(size_t idx) const {
+    return static_cast<uint8_t>(word[idx / 8] >> (56 - 8 * (idx % 8)));
+  }
+
+  // this ^= rule applied to the neighbourhoods of cond
+  template<uint8_t rule>
+  constexpr void step(const packed_half& cond) {
+    step_with(cond, [](uint64_t left, uint64_t center, uint64_t right) {
+      return apply<rule>(left, center, right);
+    });
+  }
+
+  constexpr void step(const packed_half& cond, uint8_t rule) {
+    step_with(cond, [rule](uint64_t left, uint64_t center, uint64_t right) {
+      return apply(rule, left, center, right);
+    });
+  }
+
+private:
+  template<typename Fn>
+  constexpr void step_with(const packed_half& cond, Fn fn) {
+    const uint64_t first = cond.word[0] >> 63;
+    const uint64_t last  = (cond.word[words - 1] >> (64 - tail_cells)) & 1;
+
+    for (size_t idx = 0; idx < words; ++idx) {
+      const uint64_t center = cond.word[idx];
+      const uint64_t left =
+      (center >> 1) | ((idx == 0 ? last : cond.word[idx - 1] & 1) << 63);
+      const uint64_t right =
+      (center << 1) | (idx + 1 == words ? first << (64 - tail_cells)
+                                        : cond.word[idx + 1] >> 63);
+
+      word[idx] ^= fn(left, center, right) &
+                   (idx + 1 == words ? tail_mask : ~uint64_t {0});
+    }
+  }
+};
+
+}    // namespace impl::soca
+
 namespace soca {
 
 /***
@@ -587,4 +706,405 @@ constexpr void reverse_front(Itr begin, Itr end, uint8_t rule) {
    << 7);
 }
 
+/***
+ * @brief section of compile time size held in registers between iterations
+ * @note load once, iterate any number of times, store once
+ * Same semantics as the iterator kernels of the same name, the first half
+ * of the section is the front and the second half is the back.
+ ***/
+template<size_t size>
+requires(size >= 4 && size % 2 == 0)
+class fixed_section {
+  impl::soca::packed_half<size / 2> front;
+  impl::soca::packed_half<size / 2> back;
+
+public:
+  static constexpr size_t half_size = size / 2;
+
+  template<typename Itr>
+  requires std::is_same_v<typename Itr::value_type, uint8_t> &&
+           std::random_access_iterator<Itr>
+  constexpr explicit fixed_section(Itr begin) {
+    front.load(begin);
+    back.load(begin + half_size);
+  }
+
+  template<typename Itr>
+  requires std::is_same_v<typename Itr::value_type, uint8_t> &&
+           std::random_access_iterator<Itr>
+  constexpr void store(Itr begin) const {
+    front.store(begin);
+    back.store(begin + half_size);
+  }
+
+  constexpr uint8_t front_byte(size_t idx) const {
+    return front.byte(idx);
+  }
+
+  constexpr uint8_t back_byte(size_t idx) const {
+    return back.byte(idx);
+  }
+
+  template<uint8_t rule>
+  constexpr void forward_front() {
+    front.template step<rule>(back);
+  }
+
+  template<uint8_t rule>
+  constexpr void forward_back() {
+    back.template step<rule>(front);
+  }
+
+  template<uint8_t rule>
+  constexpr void reverse_back() {
+    back.template step<rule>(front);
+  }
+
+  template<uint8_t rule>
+  constexpr void reverse_front() {
+    front.template step<rule>(back);
+  }
+
+  constexpr void forward_front(uint8_t rule) {
+    front.step(back, rule);
+  }
+
+  constexpr void forward_back(uint8_t rule) {
+    back.step(front, rule);
+  }
+
+  constexpr void reverse_back(uint8_t rule) {
+    back.step(front, rule);
+  }
+
+  constexpr void reverse_front(uint8_t rule) {
+    front.step(back, rule);
+  }
+};
+
+}    // namespace soca
+
+namespace soca {
+
+// rule is the xor of some of left, center and right, its evolution is
+// linear over GF(2)
+constexpr bool additive(uint8_t rule) {
+  const auto left   = static_cast<uint8_t>((rule >> 4 & 1) * 0b11110000);
+  const auto center = static_cast<uint8_t>((rule >> 2 & 1) * 0b11001100);
+  const auto right  = static_cast<uint8_t>((rule >> 1 & 1) * 0b10101010);
+  return rule == (left ^ center ^ right);
+}
+
+// sections jump_forward and jump_reverse take, larger ones are stepped
+inline constexpr size_t max_jump_size = 256;
+
+/***
+ * @brief the cpu has the carry-less multiply jumps are built on, checked
+ * once
+ * @note without it a portable multiply makes jumps slower than stepping at
+ * every section size and step count, jump_forward and jump_reverse decline
+ ***/
+inline bool fast_jump() {
+#if defined(CACOMPRESS_PCLMUL)
+  static const bool supported = __builtin_cpu_supports("pclmul") != 0;
+  return supported;
+#else
+  return false;
+#endif
+}
+
+}    // namespace soca
+
+#if defined(CACOMPRESS_PCLMUL)
+namespace impl::soca {
+
+struct wide_product {
+  uint64_t low;
+  uint64_t high;
+};
+
+// product of lhs and rhs as polynomials over GF(2)
+CACOMPRESS_PCLMUL inline wide_product carryless_multiply(uint64_t lhs,
+                                                         uint64_t rhs) {
+  const __m128i product =
+  _mm_clmulepi64_si128(_mm_cvtsi64_si128(static_cast<int64_t>(lhs)),
+                       _mm_cvtsi64_si128(static_cast<int64_t>(rhs)),
+                       0);
+  return {.low  = static_cast<uint64_t>(_mm_cvtsi128_si64(product)),
+          .high = static_cast<uint64_t>(
+          _mm_cvtsi128_si64(_mm_unpackhi_epi64(product, product)))};
+}
+
+/***
+ * @brief polynomial over GF(2) modulo z^cells - 1, the cells of one half of
+ * a section, in words 64 bit words
+ * @note term q is bit q % 64 of word q / 64. Cells are numbered from the
+ * end of the half, so a half loads as one big endian number: the last bit of
+ * the half is term 0. A step of an additive rule then adds p times the other
+ * half, see multiply_rule.
+ ***/
+template<size_t words>
+class cyclic_polynomial {
+  size_t                      cells;
+  std::array<uint64_t, words> word {};
+
+  // terms past cells of the last word
+  uint64_t tail_mask() const {
+    return cells % 64 == 0 ? ~uint64_t {0}
+                           : (uint64_t {1} << (cells % 64)) - 1;
+  }
+
+  // this = product modulo z^cells - 1, product holds 2 * cells - 1 terms
+  void fold(const std::array<uint64_t, 2 * words + 1>& product) {
+    const size_t skip  = cells / 64;
+    const size_t shift = cells % 64;
+    for (size_t idx = 0; idx < words; ++idx) {
+      const uint64_t low  = product[idx + skip];
+      const uint64_t high = product[idx + skip + 1];
+      word[idx] =
+      product[idx] ^ (shift == 0 ? low : low >> shift | high << (64 - shift));
+    }
+    word[words - 1] &= tail_mask();
+  }
+
+public:
+  explicit cyclic_polynomial(size_t cells, uint64_t constant = 0):
+    cells(cells) {
+    word[0] = constant;
+  }
+
+  template<typename Itr>
+  void load(Itr begin) {
+    const size_t half_size = cells / 8;
+    for (size_t idx = 0; idx < half_size; ++idx) {
+      const size_t shift  = 8 * (half_size - 1 - idx);
+      word[shift / 64]   |= static_cast<uint64_t>(begin[idx]) << (shift % 64);
+    }
+  }
+
+  template<typename Itr>
+  void store(Itr begin) const {
+    const size_t half_size = cells / 8;
+    for (size_t idx = 0; idx < half_size; ++idx) {
+      const size_t shift = 8 * (half_size - 1 - idx);
+      begin[idx] = static_cast<uint8_t>(word[shift / 64] >> (shift % 64));
+    }
+  }
+
+  cyclic_polynomial& operator+=(const cyclic_polynomial& other) {
+    for (size_t idx = 0; idx < words; ++idx) {
+      word[idx] ^= other.word[idx];
+    }
+    return *this;
+  }
+
+  friend cyclic_polynomial operator+(cyclic_polynomial        lhs,
+                                     const cyclic_polynomial& rhs) {
+    return lhs += rhs;
+  }
+
+  // word by word carry-less products, the terms past cells wrap around
+  CACOMPRESS_PCLMUL friend cyclic_polynomial operator*(
+  const cyclic_polynomial& lhs,
+  const cyclic_polynomial& rhs) {
+    std::array<uint64_t, 2 * words + 1> product {};
+    for (size_t left = 0; left < words; ++left) {
+      for (size_t right = 0; right < words; ++right) {
+        const auto [low, high] =
+        carryless_multiply(lhs.word[left], rhs.word[right]);
+        product[left + right]     ^= low;
+        product[left + right + 1] ^= high;
+      }
+    }
+
+    cyclic_polynomial result {lhs.cells};
+    result.fold(product);
+    return result;
+  }
+
+  // products of different words cancel in pairs over GF(2), a square takes
+  // one carry-less multiply per word
+  CACOMPRESS_PCLMUL cyclic_polynomial square() const {
+    std::array<uint64_t, 2 * words + 1> product {};
+    for (size_t idx = 0; idx < words; ++idx) {
+      const auto [low, high] = carryless_multiply(word[idx], word[idx]);
+      product[2 * idx]       = low;
+      product[2 * idx + 1]   = high;
+    }
+
+    cyclic_polynomial result {cells};
+    result.fold(product);
+    return result;
+  }
+
+  // this times p of an additive rule: z^-1 for left, 1 for center and z for
+  // right, whichever the rule has
+  cyclic_polynomial multiply_rule(uint8_t rule) const {
+    const uint64_t last  = word[(cells - 1) / 64] >> ((cells - 1) % 64) & 1;
+    const uint64_t first = word[0] & 1;
+
+    const uint64_t left   = -static_cast<uint64_t>(rule >> 4 & 1);
+    const uint64_t center = -static_cast<uint64_t>(rule >> 2 & 1);
+    const uint64_t right  = -static_cast<uint64_t>(rule >> 1 & 1);
+
+    cyclic_polynomial result {cells};
+    for (size_t idx = 0; idx < words; ++idx) {
+      const uint64_t up =
+      word[idx] << 1 | (idx == 0 ? last : word[idx - 1] >> 63);
+      const uint64_t down =
+      word[idx] >> 1 | (idx + 1 == words ? 0 : word[idx + 1] << 63);
+      result.word[idx] = (down & left) ^ (word[idx] & center) ^ (up & right);
+    }
+    result.word[words - 1] &= result.tail_mask();
+    result.word[(cells - 1) / 64] ^= (first & left) << ((cells - 1) % 64);
+    return result;
+  }
+};
+
+/***
+ * @brief Fibonacci polynomials F(steps - 1), F(steps) and F(steps + 1) of p
+ * @note F(0) = 0, F(1) = 1, F(n + 1) = p F(n) + F(n - 1). Doubling over
+ * the bits of steps, with F(2n) = p F(n)^2 and F(2n + 1) = F(n)^2 +
+ * F(n + 1)^2, takes log2(steps) rounds.
+ ***/
+template<size_t words>
+CACOMPRESS_PCLMUL std::array<cyclic_polynomial<words>, 3> fibonacci(
+uint8_t rule,
+size_t  cells,
+size_t  steps) {
+  cyclic_polynomial<words> current {cells};    // F(n)
+  cyclic_polynomial<words> next {cells, 1};    // F(n + 1)
+
+  for (int bit = std::bit_width(steps) - 1; bit >= 0; --bit) {
+    const auto current_square = current.square();
+    current                   = current_square.multiply_rule(rule);
+    next                      = current_square + next.square();
+
+    if ((steps >> bit & 1) != 0) {
+      const auto following = next.multiply_rule(rule) + current;
+      current              = next;
+      next                 = following;
+    }
+  }
+
+  return {next + current.multiply_rule(rule), current, next};
+}
+
+/***
+ * @brief generation target from the halves of generation source: S(target)
+ * into the front and S(target + 1) into the back, or the other way round
+ * for an odd target
+ * @note S(0), S(1) are the halves of generation 0 and S(n + 1) =
+ * p S(n) + S(n - 1), which runs the same both ways
+ ***/
+template<size_t words, typename Itr>
+CACOMPRESS_PCLMUL void jump(
+Itr begin, Itr end, uint8_t rule, size_t source, size_t target) {
+  const size_t half_size = std::distance(begin, end) / 2;
+  const size_t cells     = half_size * 8;
+
+  cyclic_polynomial<words> front {cells};
+  cyclic_polynomial<words> back {cells};
+  front.load(begin);
+  back.load(begin + half_size);
+
+  // S(source) and S(source + 1)
+  const auto& current = source % 2 == 0 ? front : back;
+  const auto& next    = source % 2 == 0 ? back : front;
+
+  cyclic_polynomial<words> first {cells};     // S(target)
+  cyclic_polynomial<words> second {cells};    // S(target + 1)
+
+  if (target >= source) {
+    const auto [before, at, after] =
+    fibonacci<words>(rule, cells, target - source);
+    first  = at * next + before * current;
+    second = after * next + at * current;
+  } else {
+    const auto [before, at, after] =
+    fibonacci<words>(rule, cells, source - target);
+    first  = after * current + at * next;
+    second = at * current + before * next;
+  }
+
+  if (target % 2 == 0) {
+    first.store(begin);
+    second.store(begin + half_size);
+  } else {
+    second.store(begin);
+    first.store(begin + half_size);
+  }
+}
+
+// jump sized to the words of the half, up to the halves of max_jump_size
+template<typename Itr>
+CACOMPRESS_PCLMUL void jump_any(
+Itr begin, Itr end, uint8_t rule, size_t source, size_t target) {
+  const size_t words = (std::distance(begin, end) * 4 + 63) / 64;
+
+  [&]<size_t... idx>(std::index_sequence<idx...> /*unused*/) {
+    ((words == idx + 1 ? jump<idx + 1>(begin, end, rule, source, target)
+                       : void()),
+     ...);
+  }(std::make_index_sequence<::soca::max_jump_size * 4 / 64> {});
+}
+
+}    // namespace impl::soca
+#endif
+
+namespace soca {
+
+/***
+ * @brief steps generations forward at once, as that many forward_front and
+ * forward_back calls from generation
+ * @note the evolution of an additive rule is linear: a step adds p times
+ * one half to the other, halves being polynomials modulo z^cells - 1. The
+ * jump costs log2(steps) squarings and four products of polynomials in
+ * carry-less multiplies.
+ * @warning UNDEFINED BEHAVIOR FOR RANGES OF SIZE (LESS THAN 4 || ODD)
+ * @return false, leaving the range as is, for a rule that is not additive,
+ * a range over max_jump_size or a cpu without fast_jump
+ ***/
+template<typename Itr>
+requires std::is_same_v<typename Itr::value_type, uint8_t> &&
+         std::random_access_iterator<Itr>
+bool jump_forward(Itr     begin,
+                  Itr     end,
+                  uint8_t rule,
+                  size_t  generation,
+                  size_t  steps) {
+  if (!fast_jump() || !additive(rule) ||
+      static_cast<size_t>(std::distance(begin, end)) > max_jump_size) {
+    return false;
+  }
+#if defined(CACOMPRESS_PCLMUL)
+  impl::soca::jump_any(begin, end, rule, generation, generation + steps);
+#endif
+  return true;
+}
+
+/***
+ * @brief steps generations back at once, as that many reverse_back and
+ * reverse_front calls from generation, see jump_forward
+ * @warning UNDEFINED BEHAVIOR FOR RANGES OF SIZE (LESS THAN 4 || ODD) OR
+ * STEPS OVER GENERATION
+ ***/
+template<typename Itr>
+requires std::is_same_v<typename Itr::value_type, uint8_t> &&
+         std::random_access_iterator<Itr>
+bool jump_reverse(Itr     begin,
+                  Itr     end,
+                  uint8_t rule,
+                  size_t  generation,
+                  size_t  steps) {
+  if (!fast_jump() || !additive(rule) ||
+      static_cast<size_t>(std::distance(begin, end)) > max_jump_size) {
+    return false;
+  }
+#if defined(CACOMPRESS_PCLMUL)
+  impl::soca::jump_any(begin, end, rule, generation, generation - steps);
+#endif
+  return true;
+}
+
 }    // namespace soca
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+#elif defined(_M_X64) || defined(_M_IX86)
+  #include <intrin.h>
+#endif
+
+// define to 1 to record statistics, 0 compiles every recording site out
+#ifndef CACOMPRESS_STATS
+  #define CACOMPRESS_STATS 0
+#endif
+
+namespace stats {
+
+inline constexpr bool enabled = CACOMPRESS_STATS != 0;
+
+// time stamp counter cycles on x86, nanoseconds elsewhere
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+defined(_M_IX86)
+inline constexpr const char* tick_unit = "cycles";
+#else
+inline constexpr const char* tick_unit = "ns";
+#endif
+
+struct stage {
+  uint64_t ticks;
+  uint64_t calls;
+};
+
+/***
+ * @brief counters of the compress and decompress calls of one thread
+ * @note search includes the entropy evaluations, which are also in entropy
+ ***/
+struct counters {
+  stage search;            // SOCA count search per section
+  stage entropy;           // calculate_entropy per generation
+  stage huffman_tree;      // tree and code table of encode
+  stage huffman_output;    // tree and message bits of encode
+  stage huffman_decode;    // tree and message bits of decode
+  stage reverse;           // SOCA reverse per section
+
+  uint64_t compress_bytes_in;
+  uint64_t compress_bytes_out;
+  uint64_t decompress_bytes_in;
+  uint64_t decompress_bytes_out;
+
+  uint64_t                  sections;
+  uint64_t                  generations;      // SOCA steps evaluated by search
+  std::array<uint64_t, 256> chosen_counts;    // sections per count, runs too
+
+  uint64_t                  max_tree_depth;
+  std::array<uint64_t, 256> code_lengths;    // symbols per code length
+
+  uint64_t memo_hits;      // sections whose search a memo::cache had
+  uint64_t memo_misses;    // sections searched and put in a memo::cache
+
+  uint64_t uniform_sections;    // single byte sections the rule keeps as is
+};
+
+inline counters& current() {
+  static thread_local counters thread_counters {};
+  return thread_counters;
+}
+
+inline void reset() {
+  current() = counters {};
+}
+
+}    // namespace stats
+
+namespace impl::stats {
+
+inline uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+defined(_M_IX86)
+  return __rdtsc();
+#else
+  return static_cast<uint64_t>(
+  std::chrono::duration_cast<std::chrono::nanoseconds>(
+  std::chrono::steady_clock::now().time_since_epoch())
+  .count());
+#endif
+}
+
+using stage_member = decltype(&::stats::counters::search);
+
+// adds its lifetime, or until stop(), to a stage of the current counters
+class stage_timer {
+  ::stats::stage* target {nullptr};
+  uint64_t        start {0};
+
+public:
+  explicit stage_timer(stage_member stage) {
+    if constexpr (::stats::enabled) {
+      target = &(::stats::current().*stage);
+      start  = ticks();
+    }
+  }
+
+  stage_timer(const stage_timer&)            = delete;
+  stage_timer& operator=(const stage_timer&) = delete;
+
+  ~stage_timer() {
+    stop();
+  }
+
+  void stop() {
+    if constexpr (::stats::enabled) {
+      if (target != nullptr) {
+        target->ticks += ticks() - start;
+        ++target->calls;
+        target = nullptr;
+      }
+    }
+  }
+};
+
+// fn(counters&) if enabled
+template<typename Fn>
+void record(Fn fn) {
+  if constexpr (::stats::enabled) {
+    fn(::stats::current());
+  }
+}
+
+inline std::string stage_json(const ::stats::stage& stage) {
+  return "{\"ticks\": " + std::to_string(stage.ticks) +
+         ", \"calls\": " + std::to_string(stage.calls) + "}";
+}
+
+// {"index": value, ...} of the non zero entries
+inline std::string sparse_json(const std::array<uint64_t, 256>& values) {
+  std::string json  = "{";
+  bool        first = true;
+  for (size_t idx = 0; idx < values.size(); ++idx) {
+    if (values[idx] == 0) {
+      continue;
+    }
+    json += (first ? "\"" : ", \"") + std::to_string(idx) +
+            "\": " + std::to_string(values[idx]);
+    first = false;
+  }
+  return json + "}";
+}
+
+}    // namespace impl::stats
+
+namespace stats {
+
+inline std::string to_json(const counters& stats) {
+  using impl::stats::sparse_json;
+  using impl::stats::stage_json;
+
+  return std::string {"{\n"} + "  \"enabled\": " +
+         (enabled ? "true" : "false") + ",\n  \"tick_unit\": \"" + tick_unit +
+         "\",\n  \"stages\": {\n" +
+         "    \"search\": " + stage_json(stats.search) + ",\n" +
+         "    \"entropy\": " + stage_json(stats.entropy) + ",\n" +
+         "    \"huffman_tree\": " + stage_json(stats.huffman_tree) + ",\n" +
+         "    \"huffman_output\": " + stage_json(stats.huffman_output) + ",\n" +
+         "    \"huffman_decode\": " + stage_json(stats.huffman_decode) + ",\n" +
+         "    \"reverse\": " + stage_json(stats.reverse) + "\n  },\n" +
+         "  \"compress_bytes_in\": " + std::to_string(stats.compress_bytes_in) +
+         ",\n  \"compress_bytes_out\": " +
+         std::to_string(stats.compress_bytes_out) +
+         ",\n  \"decompress_bytes_in\": " +
+         std::to_string(stats.decompress_bytes_in) +
+         ",\n  \"decompress_bytes_out\": " +
+         std::to_string(stats.decompress_bytes_out) +
+         ",\n  \"sections\": " + std::to_string(stats.sections) +
+         ",\n  \"generations\": " + std::to_string(stats.generations) +
+         ",\n  \"chosen_counts\": " + sparse_json(stats.chosen_counts) +
+         ",\n  \"max_tree_depth\": " + std::to_string(stats.max_tree_depth) +
+         ",\n  \"code_lengths\": " + sparse_json(stats.code_lengths) +
+         ",\n  \"memo_hits\": " + std::to_string(stats.memo_hits) +
+         ",\n  \"memo_misses\": " + std::to_string(stats.memo_misses) +
+         ",\n  \"uniform_sections\": " +
+         std::to_string(stats.uniform_sections) + "\n}\n";
+}
+
+}    // namespace stats
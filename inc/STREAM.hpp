@@ -0,0 +1,859 @@
+#pragma once
+
+#include "COMPRESS.hpp"
+#include "SHUFFLE.hpp"
+#include "TRANSFORM.hpp"
+#include "UTIL.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <ranges>
+#include <stdexcept>
+#include <vector>
+
+namespace stream {
+
+// rule and section size are recorded for the decoder, depth for reference
+// and block_size only shapes the encoder output. indexed streams end with a
+// block index for decompress_range. Ahead of the SOCA search blocks pass
+// through the transforms in order, see TRANSFORM.hpp, then are shuffled by
+// element_width, see SHUFFLE.hpp. entropy selects the coder of the sections,
+// run_tokens whether full uniform sections are woven as runs.
+struct parameters {
+  uint8_t                       rule          = 220;
+  size_t                        section_size  = 40;
+  uint8_t                       depth         = impl::compress::max_count;
+  size_t                        block_size    = size_t {1} << 20;
+  bool                          indexed       = false;
+  shuffle::mode                 shuffle       = shuffle::mode::none;
+  size_t                        element_width = 1;
+  std::vector<transform::stage> transforms    = {};
+  entropy_model                 entropy       = entropy_model::order0;
+  size_t                        memo_slots    = 0;    // 0 for no memo::cache
+  bool                          run_tokens    = true;
+
+  // see compression_context, the budget holds per block
+  double generation_penalty = 0.0;
+  size_t generation_budget  = std::numeric_limits<size_t>::max();
+};
+
+}    // namespace stream
+
+namespace impl::stream {
+
+// Stream format:
+// (3 bytes) magic -> (byte) version -> (byte) rule -> (byte) depth
+// -> [version 2: (byte) flags] -> [shuffled: (varint) element width]
+// -> [transformed: (varint) stage count -> per stage (byte) kind
+//    -> [stride_delta, xor_record: (varint) distance]]
+// -> (varint) section size -> blocks
+// -> [indexed: index block] -> (byte) end block type
+// -> [indexed: (8 bytes) position of the index block]
+// Block format:
+// (byte) type -> (varint) raw size -> (varint) payload size -> payload
+// Index block: raw size is the size of the stream, payload holds per block
+// (8 bytes) its raw offset -> (8 bytes) position of its header
+// Positions count from the first magic byte, fixed size fields are little
+// endian.
+
+constexpr std::array<uint8_t, 3> magic {'C', 'A', 'C'};
+constexpr uint8_t                version = 2;
+// no flags byte, still written for streams without flags so they stay
+// readable by version 1 decoders
+constexpr uint8_t unflagged_version = 1;
+
+constexpr uint8_t flag_indexed       = 1;
+constexpr uint8_t flag_shuffle_bytes = 2;     // soca blocks byte shuffled
+constexpr uint8_t flag_shuffle_bits  = 4;     // soca blocks bit shuffled
+constexpr uint8_t flag_transformed   = 8;     // soca blocks transformed
+constexpr uint8_t flag_order1        = 16;    // soca blocks order-1 coded
+constexpr uint8_t flag_runs          = 32;    // soca blocks may hold runs
+
+enum class block_type : uint8_t {
+  end    = 0,
+  soca   = 1,    // huffman coded SOCA sections, see compress()
+  stored = 2,    // raw bytes, payload size equals raw size
+  index  = 3,    // block offsets, see the stream format
+};
+
+constexpr size_t index_entry_size = 16;
+
+struct index_entry {
+  size_t raw_offset;
+  size_t position;
+};
+
+struct block_header {
+  block_type type;
+  size_t     raw_size;
+  size_t     payload_size;
+};
+
+// @throws std::runtime_error on truncated input
+template<typename Itr>
+uint8_t read_byte(Itr& itr, Itr end) {
+  if (itr == end) {
+    throw std::runtime_error("truncated stream");
+  }
+  return *itr++;
+}
+
+template<typename ItrOut>
+ItrOut write_fixed64(ItrOut out, uint64_t value) {
+  for (size_t byte = 0; byte < 8; ++byte) {
+    *out++ = static_cast<uint8_t>(value >> (8 * byte));
+  }
+  return out;
+}
+
+// @throws std::runtime_error on truncated input
+template<typename Itr>
+uint64_t read_fixed64(Itr& itr, Itr end) {
+  uint64_t value = 0;
+  for (size_t byte = 0; byte < 8; ++byte) {
+    value |= uint64_t {read_byte(itr, end)} << (8 * byte);
+  }
+  return value;
+}
+
+inline uint8_t flags_of(const ::stream::parameters& params) {
+  uint8_t flags = params.indexed ? flag_indexed : 0;
+  if (!params.transforms.empty()) {
+    flags |= flag_transformed;
+  }
+  if (params.entropy == entropy_model::order1) {
+    flags |= flag_order1;
+  }
+  if (params.run_tokens) {
+    flags |= flag_runs;
+  }
+  switch (params.shuffle) {
+    case ::shuffle::mode::none:
+      break;
+    case ::shuffle::mode::bytes:
+      flags |= flag_shuffle_bytes;
+      break;
+    case ::shuffle::mode::bits:
+      flags |= flag_shuffle_bits;
+      break;
+  }
+  return flags;
+}
+
+inline bool has_distance(::transform::kind kind) {
+  return kind == ::transform::kind::stride_delta ||
+         kind == ::transform::kind::xor_record;
+}
+
+template<typename ItrOut>
+ItrOut write_header(ItrOut out, const ::stream::parameters& params) {
+  const uint8_t flags = flags_of(params);
+
+  out    = std::copy(magic.begin(), magic.end(), out);
+  *out++ = flags != 0 ? version : unflagged_version;
+  *out++ = params.rule;
+  *out++ = params.depth;
+  if (flags != 0) {
+    *out++ = flags;
+  }
+  if (params.shuffle != ::shuffle::mode::none) {
+    out = util::write_varint(out, params.element_width);
+  }
+  if (!params.transforms.empty()) {
+    out = util::write_varint(out, params.transforms.size());
+    for (const auto& stage : params.transforms) {
+      *out++ = static_cast<uint8_t>(stage.type);
+      if (has_distance(stage.type)) {
+        out = util::write_varint(out, stage.distance);
+      }
+    }
+  }
+  return util::write_varint(out, params.section_size);
+}
+
+// @throws std::runtime_error if the input is not a stream of this version
+template<typename ItrIn>
+::stream::parameters read_header(ItrIn& itr, ItrIn end) {
+  for (const uint8_t expected : magic) {
+    if (read_byte(itr, end) != expected) {
+      throw std::runtime_error("not a cacompress stream");
+    }
+  }
+  const uint8_t stream_version = read_byte(itr, end);
+  if (stream_version != version && stream_version != unflagged_version) {
+    throw std::runtime_error("unsupported stream version");
+  }
+
+  ::stream::parameters params;
+  params.rule  = read_byte(itr, end);
+  params.depth = read_byte(itr, end);
+
+  // set by the flags, version 1 streams have no runs
+  params.run_tokens = false;
+
+  if (stream_version != unflagged_version) {
+    constexpr uint8_t known_flags = flag_indexed | flag_shuffle_bytes |
+                                    flag_shuffle_bits | flag_transformed |
+                                    flag_order1 | flag_runs;
+
+    const uint8_t flags = read_byte(itr, end);
+    if ((flags & ~known_flags) != 0 ||
+        ((flags & flag_shuffle_bytes) != 0 &&
+         (flags & flag_shuffle_bits) != 0)) {
+      throw std::runtime_error("unknown stream flags");
+    }
+    params.indexed = (flags & flag_indexed) != 0;
+    if ((flags & flag_order1) != 0) {
+      params.entropy = entropy_model::order1;
+    }
+    params.run_tokens = (flags & flag_runs) != 0;
+
+    if ((flags & flag_shuffle_bytes) != 0) {
+      params.shuffle = ::shuffle::mode::bytes;
+    } else if ((flags & flag_shuffle_bits) != 0) {
+      params.shuffle = ::shuffle::mode::bits;
+    }
+    if (params.shuffle != ::shuffle::mode::none) {
+      params.element_width = util::read_varint(itr, end);
+      if (params.element_width == 0) {
+        throw std::runtime_error("invalid element width");
+      }
+    }
+
+    if ((flags & flag_transformed) != 0) {
+      const size_t count = util::read_varint(itr, end);
+      if (count == 0 || count > ::transform::max_stages) {
+        throw std::runtime_error("invalid transforms");
+      }
+      for (size_t idx = 0; idx < count; ++idx) {
+        ::transform::stage stage {
+        .type = static_cast<::transform::kind>(read_byte(itr, end))};
+        if (stage.type < ::transform::kind::delta ||
+            stage.type > ::transform::kind::move_to_front) {
+          throw std::runtime_error("unknown transform");
+        }
+        if (has_distance(stage.type)) {
+          stage.distance = util::read_varint(itr, end);
+          if (stage.distance == 0) {
+            throw std::runtime_error("invalid transform distance");
+          }
+        }
+        params.transforms.push_back(stage);
+      }
+    }
+  }
+
+  params.section_size = util::read_varint(itr, end);
+
+  if (params.section_size == 0) {
+    throw std::runtime_error("invalid section size");
+  }
+
+  return params;
+}
+
+template<typename ItrOut>
+ItrOut write_block_header(ItrOut out, const block_header& header) {
+  *out++ = static_cast<uint8_t>(header.type);
+  if (header.type == block_type::end) {
+    return out;
+  }
+  out = util::write_varint(out, header.raw_size);
+  return util::write_varint(out, header.payload_size);
+}
+
+// bytes write_header and write_block_header write, positions of the index
+inline size_t header_size(const ::stream::parameters& params) {
+  std::array<uint8_t, 128> scratch {};
+  return write_header(scratch.begin(), params) - scratch.begin();
+}
+
+inline size_t block_header_size(const block_header& header) {
+  std::array<uint8_t, 32> scratch {};
+  return write_block_header(scratch.begin(), header) - scratch.begin();
+}
+
+// @throws std::runtime_error on truncated input or unknown block type
+template<typename ItrIn>
+block_header read_block_header(ItrIn& itr, ItrIn end) {
+  const auto   type = static_cast<block_type>(read_byte(itr, end));
+  block_header header {.type = type, .raw_size = 0, .payload_size = 0};
+
+  switch (header.type) {
+    case block_type::end:
+      return header;
+    case block_type::soca:
+    case block_type::stored:
+    case block_type::index:
+      break;
+    default:
+      throw std::runtime_error("unknown block type");
+  }
+
+  header.raw_size     = util::read_varint(itr, end);
+  header.payload_size = util::read_varint(itr, end);
+
+  if (static_cast<size_t>(std::distance(itr, end)) < header.payload_size) {
+    throw std::runtime_error("truncated block");
+  }
+  if (header.type == block_type::stored &&
+      header.payload_size != header.raw_size) {
+    throw std::runtime_error("block size mismatch");
+  }
+  if (header.type == block_type::index &&
+      header.payload_size % index_entry_size != 0) {
+    throw std::runtime_error("invalid block index");
+  }
+
+  return header;
+}
+
+/***
+ * @brief whether a soca block of size bytes counted in histogram can not be
+ * smaller than the input
+ * @note the order-0 entropy plus the huffman tree (10 bits per used byte
+ * value) and pad byte bound the soca payload from below, assuming the SOCA
+ * search does not lower the entropy, which holds for data close to random
+ ***/
+inline bool incompressible(util::histogram& histogram, size_t size) {
+  const auto& freq = histogram.bins();
+  const auto  used =
+  std::count_if(freq.begin(), freq.end(), [](size_t f) { return f != 0; });
+  const double bound = (histogram.entropy() + 10.0 * used) / 8.0 + 1.0;
+
+  return bound >= static_cast<double>(size);
+}
+
+// decodes the soca block payload [begin, end) into block, shuffled holds the
+// decoded block of shuffled streams before it is unshuffled. Transforms are
+// reverted in block.
+// @throws std::runtime_error if it does not decode to raw_size bytes
+template<typename ItrIn>
+void decode_block(ItrIn                       begin,
+                  ItrIn                       end,
+                  size_t                      raw_size,
+                  const ::stream::parameters& params,
+                  std::vector<uint8_t>&       block,
+                  std::vector<uint8_t>&       shuffled,
+                  decompression_context&      context) {
+  const bool unshuffle = params.shuffle != ::shuffle::mode::none;
+
+  auto& decoded = unshuffle ? shuffled : block;
+  decoded.clear();
+  ::decompress(begin,
+               end,
+               std::back_inserter(decoded),
+               context,
+               params.rule,
+               params.section_size);
+
+  if (decoded.size() != raw_size) {
+    throw std::runtime_error("block size mismatch");
+  }
+
+  if (unshuffle) {
+    block.resize(raw_size);
+    ::shuffle::revert(params.shuffle, shuffled, block, params.element_width);
+  }
+
+  if (!params.transforms.empty()) {
+    ::transform::chain {params.transforms}.revert(block);
+  }
+}
+
+/***
+ * @brief the index entry of the block holding byte offset of an indexed stream
+ * @note binary search over the index, found by the position after the end
+ * block, the blocks are not read
+ * @param size set to the size of the stream
+ * @throws std::runtime_error if the stream has no valid index
+ ***/
+template<typename ItrIn>
+index_entry find_block(ItrIn begin, ItrIn end, size_t offset, size_t& size) {
+  if (std::distance(begin, end) < 8) {
+    throw std::runtime_error("missing block index");
+  }
+
+  const auto footer   = end - 8;
+  auto       itr      = footer;
+  const auto position = read_fixed64(itr, end);
+  if (position >= static_cast<size_t>(std::distance(begin, footer))) {
+    throw std::runtime_error("missing block index");
+  }
+
+  itr               = begin + static_cast<ptrdiff_t>(position);
+  const auto header = read_block_header(itr, footer);
+  if (header.type != block_type::index) {
+    throw std::runtime_error("missing block index");
+  }
+  size = header.raw_size;
+
+  const auto entry = [&](size_t idx) {
+    auto entry_itr = itr + static_cast<ptrdiff_t>(idx * index_entry_size);
+    const auto raw_offset = read_fixed64(entry_itr, footer);
+    return index_entry {.raw_offset = raw_offset,
+                        .position   = read_fixed64(entry_itr, footer)};
+  };
+
+  const size_t count = header.payload_size / index_entry_size;
+  if (count == 0) {    // empty stream, its index is the first block
+    return {.raw_offset = 0, .position = position};
+  }
+
+  // first entry past offset, entries ascend in raw offset from 0
+  size_t low  = 0;
+  size_t high = count;
+  while (low < high) {
+    const size_t middle = low + (high - low) / 2;
+    if (entry(middle).raw_offset <= offset) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  if (low == 0) {
+    throw std::runtime_error("invalid block index");
+  }
+
+  const auto found = entry(low - 1);
+  if (found.position >= position) {
+    throw std::runtime_error("invalid block index");
+  }
+  return found;
+}
+
+}    // namespace impl::stream
+
+namespace stream {
+
+/***
+ * @brief compress into a self describing stream
+ * @note input is cut into blocks of params.block_size, each compressed with
+ * the runtime compress(), blocks which fail the entropy pre-check or would not
+ * shrink are stored raw
+ * @throws std::invalid_argument for a section_size or block_size of 0, depth
+ * above impl::compress::max_count, a shuffle with element_width 0 or invalid
+ * transforms
+ ***/
+template<typename ItrIn, typename ItrOut>
+requires std::random_access_iterator<ItrIn>
+ItrOut compress(ItrIn begin, ItrIn end, ItrOut out, const parameters& params) {
+  // checked up front, a stream of stored blocks never reaches compress()
+  if (params.section_size == 0) {
+    throw std::invalid_argument("section_size must be positive");
+  }
+  if (params.depth > impl::compress::max_count) {
+    throw std::invalid_argument("depth must not exceed max_count");
+  }
+  if (params.block_size == 0) {
+    throw std::invalid_argument("block_size must be positive");
+  }
+  if (params.shuffle != shuffle::mode::none && params.element_width == 0) {
+    throw std::invalid_argument("element_width must be positive");
+  }
+
+  out = impl::stream::write_header(out, params);
+
+  transform::chain transforms {params.transforms};
+
+  std::vector<uint8_t> payload;
+  std::vector<uint8_t> transformed;
+  std::vector<uint8_t> shuffled;
+
+  compression_context context;
+  context.model              = params.entropy;
+  context.generation_penalty = params.generation_penalty;
+  context.generation_budget  = params.generation_budget;
+  context.run_tokens         = params.run_tokens;
+
+  // remembered across the blocks of the stream
+  std::optional<memo::cache> memo;
+  if (params.memo_slots != 0) {
+    context.memo = &memo.emplace(params.memo_slots);
+  }
+
+  // the block histogram of the stored block check is the first of the search
+  const auto encode_block = [&](auto block_begin, auto block_end) {
+    payload.clear();
+
+    auto& histogram = context.input_histogram.emplace();
+    histogram.add(block_begin, block_end);
+
+    const auto block_size =
+    static_cast<size_t>(std::distance(block_begin, block_end));
+    if (impl::stream::incompressible(histogram, block_size)) {
+      context.input_histogram.reset();
+    } else {
+      ::compress(block_begin,
+                 block_end,
+                 std::back_inserter(payload),
+                 context,
+                 params.rule,
+                 params.section_size,
+                 params.depth);
+    }
+  };
+
+  // raw offset and position of each block, for the index
+  std::vector<impl::stream::index_entry> index;
+  size_t position = impl::stream::header_size(params);
+
+  const auto write_block = [&](const impl::stream::block_header& header,
+                               auto                              payload_begin,
+                               auto                              payload_end) {
+    out = impl::stream::write_block_header(out, header);
+    out = std::copy(payload_begin, payload_end, out);
+    position += impl::stream::block_header_size(header) + header.payload_size;
+  };
+
+  const auto size = std::distance(begin, end);
+  const auto step = static_cast<ptrdiff_t>(params.block_size);
+
+  for (ptrdiff_t start = 0; start < size; start += step) {
+    const auto block_begin = begin + start;
+    const auto block_end   = begin + std::min(start + step, size);
+
+    const auto raw_size =
+    static_cast<size_t>(std::distance(block_begin, block_end));
+
+    if (params.indexed) {
+      index.push_back({.raw_offset = static_cast<size_t>(start),
+                       .position   = position});
+    }
+
+    if (params.shuffle == shuffle::mode::none && transforms.empty()) {
+      encode_block(block_begin, block_end);
+    } else {
+      transformed.assign(block_begin, block_end);
+      transforms.apply(transformed);
+
+      if (params.shuffle == shuffle::mode::none) {
+        encode_block(transformed.begin(), transformed.end());
+      } else {
+        shuffled.resize(raw_size);
+        shuffle::apply(params.shuffle,
+                       transformed,
+                       shuffled,
+                       params.element_width);
+        encode_block(shuffled.begin(), shuffled.end());
+      }
+    }
+
+    if (payload.empty() || payload.size() >= raw_size) {
+      write_block(
+      impl::stream::block_header {.type = impl::stream::block_type::stored,
+                                  .raw_size     = raw_size,
+                                  .payload_size = raw_size},
+      block_begin,
+      block_end);
+      continue;
+    }
+
+    write_block(
+    impl::stream::block_header {.type         = impl::stream::block_type::soca,
+                                .raw_size     = raw_size,
+                                .payload_size = payload.size()},
+    payload.begin(),
+    payload.end());
+  }
+
+  const size_t index_position = position;
+  if (params.indexed) {
+    payload.clear();
+    for (const auto& entry : index) {
+      auto inserter = std::back_inserter(payload);
+      inserter      = impl::stream::write_fixed64(inserter, entry.raw_offset);
+      impl::stream::write_fixed64(inserter, entry.position);
+    }
+
+    write_block(
+    impl::stream::block_header {.type     = impl::stream::block_type::index,
+                                .raw_size = static_cast<size_t>(size),
+                                .payload_size = payload.size()},
+    payload.begin(),
+    payload.end());
+  }
+
+  out = impl::stream::write_block_header(
+  out,
+  impl::stream::block_header {.type         = impl::stream::block_type::end,
+                              .raw_size     = 0,
+                              .payload_size = 0});
+
+  if (params.indexed) {
+    out = impl::stream::write_fixed64(out, index_position);
+  }
+  return out;
+}
+
+// parameters recorded in the header of a stream
+template<typename ItrIn>
+requires std::random_access_iterator<ItrIn>
+parameters read_parameters(ItrIn begin, ItrIn end) {
+  return impl::stream::read_header(begin, end);
+}
+
+/***
+ * @brief decompress a stream written by stream::compress
+ * @throws std::runtime_error on malformed input
+ ***/
+template<typename ItrIn, typename ItrOut>
+requires std::random_access_iterator<ItrIn>
+ItrOut decompress(ItrIn begin, ItrIn end, ItrOut out) {
+  auto             itr    = begin;
+  const parameters params = impl::stream::read_header(itr, end);
+
+  std::vector<uint8_t>  block;
+  std::vector<uint8_t>  shuffled;
+  decompression_context context;
+  context.model = params.entropy;
+
+  while (true) {
+    const auto header = impl::stream::read_block_header(itr, end);
+    if (header.type == impl::stream::block_type::end) {
+      return out;
+    }
+
+    const auto payload_end = itr + header.payload_size;
+
+    if (header.type == impl::stream::block_type::index) {
+      itr = payload_end;
+      continue;
+    }
+
+    if (header.type == impl::stream::block_type::stored) {
+      out = std::copy(itr, payload_end, out);
+      itr = payload_end;
+      continue;
+    }
+
+    impl::stream::decode_block(itr,
+                               payload_end,
+                               header.raw_size,
+                               params,
+                               block,
+                               shuffled,
+                               context);
+
+    out = std::copy(block.begin(), block.end(), out);
+    itr = payload_end;
+  }
+}
+
+/***
+ * @brief decompress the bytes [offset, offset + length) of a stream
+ * @note only the blocks overlapping the range are decoded, in those huffman
+ * decoding stops at the end of the range and only the sections overlapping it
+ * are reversed. Indexed streams find the first block by a binary search of
+ * the index, others by skipping block headers.
+ * @throws std::out_of_range if the range ends past the end of the stream
+ * @throws std::runtime_error on malformed input
+ ***/
+template<typename ItrIn, typename ItrOut>
+requires std::random_access_iterator<ItrIn>
+ItrOut decompress_range(ItrIn  begin,
+                        ItrIn  end,
+                        ItrOut out,
+                        size_t offset,
+                        size_t length) {
+  auto             itr    = begin;
+  const parameters params = impl::stream::read_header(itr, end);
+
+  if (length == 0) {
+    return out;
+  }
+  if (length > std::numeric_limits<size_t>::max() - offset) {
+    throw std::out_of_range("range exceeds the stream size");
+  }
+  const size_t range_end = offset + length;
+
+  // raw offset of the block at itr
+  size_t block_offset = 0;
+
+  if (params.indexed) {
+    size_t     size  = 0;
+    const auto entry = impl::stream::find_block(begin, end, offset, size);
+    if (range_end > size) {
+      throw std::out_of_range("range exceeds the stream size");
+    }
+    itr          = begin + static_cast<ptrdiff_t>(entry.position);
+    block_offset = entry.raw_offset;
+  }
+
+  std::vector<uint8_t>  block;
+  std::vector<uint8_t>  shuffled;
+  decompression_context context;
+  context.model = params.entropy;
+
+  while (block_offset < range_end) {
+    const auto header = impl::stream::read_block_header(itr, end);
+    if (header.type == impl::stream::block_type::end) {
+      throw std::out_of_range("range exceeds the stream size");
+    }
+
+    const auto payload_end = itr + header.payload_size;
+    const auto block_end   = block_offset + header.raw_size;
+
+    if (header.type != impl::stream::block_type::index && block_end > offset) {
+      const size_t first = std::max(offset, block_offset) - block_offset;
+      const size_t last  = std::min(range_end, block_end) - block_offset;
+
+      if (header.type == impl::stream::block_type::stored) {
+        out = std::copy(itr + first, itr + last, out);
+      } else if (params.shuffle != shuffle::mode::none ||
+                 !params.transforms.empty()) {
+        // a section of a shuffled block holds bytes from all of the block,
+        // reverting transforms needs the bytes before the range
+        impl::stream::decode_block(itr,
+                                   payload_end,
+                                   header.raw_size,
+                                   params,
+                                   block,
+                                   shuffled,
+                                   context);
+        out = std::copy(block.begin() + first, block.begin() + last, out);
+      } else {
+        block.clear();
+        ::decompress_range(itr,
+                           payload_end,
+                           std::back_inserter(block),
+                           context,
+                           params.rule,
+                           params.section_size,
+                           first,
+                           last - first);
+        out = std::copy(block.begin(), block.end(), out);
+      }
+    }
+
+    if (header.type != impl::stream::block_type::index) {
+      block_offset = block_end;
+    }
+    itr = payload_end;
+  }
+
+  return out;
+}
+
+/***
+ * @brief input range of the bytes of a stream, decoded a block at a time as
+ * the range is iterated
+ * @note only the current block is held, so memory stays at one block however
+ * long the stream, and nothing past the block being read is decoded when
+ * iteration stops early. Composes with std::views like filter and take.
+ * Single pass: the header is read by the constructor, blocks by begin() and
+ * increments, which throw when they reach malformed input.
+ * @throws std::runtime_error on malformed input
+ ***/
+template<typename ItrIn>
+requires std::random_access_iterator<ItrIn>
+class decompress_view
+  : public std::ranges::view_interface<decompress_view<ItrIn>> {
+  ItrIn      input {};
+  ItrIn      input_end {};
+  parameters params {};
+
+  std::vector<uint8_t>  block;
+  std::vector<uint8_t>  shuffled;
+  size_t                position {0};
+  bool                  started {false};
+  bool                  finished {false};
+  decompression_context context;
+
+  // reads blocks until one holds bytes or the end block is reached
+  void next_block() {
+    position = 0;
+    do {
+      const auto header = impl::stream::read_block_header(input, input_end);
+      if (header.type == impl::stream::block_type::end) {
+        block.clear();
+        finished = true;
+        return;
+      }
+
+      const auto payload_end = input + header.payload_size;
+
+      if (header.type == impl::stream::block_type::index) {
+        block.clear();
+      } else if (header.type == impl::stream::block_type::stored) {
+        block.assign(input, payload_end);
+      } else {
+        impl::stream::decode_block(input,
+                                   payload_end,
+                                   header.raw_size,
+                                   params,
+                                   block,
+                                   shuffled,
+                                   context);
+      }
+      input = payload_end;
+    } while (block.empty());
+  }
+
+public:
+  class iterator {
+    decompress_view* view {nullptr};
+
+  public:
+    using value_type      = uint8_t;
+    using difference_type = ptrdiff_t;
+
+    iterator() = default;
+
+    explicit iterator(decompress_view* view): view(view) {
+    }
+
+    uint8_t operator*() const {
+      return view->block[view->position];
+    }
+
+    iterator& operator++() {
+      if (++view->position == view->block.size()) {
+        view->next_block();
+      }
+      return *this;
+    }
+
+    void operator++(int) {
+      ++*this;
+    }
+
+    bool operator==(std::default_sentinel_t) const {
+      return view->finished;
+    }
+  };
+
+  decompress_view() = default;
+
+  decompress_view(ItrIn begin, ItrIn end):
+    input(begin),
+    input_end(end),
+    params(impl::stream::read_header(input, input_end)) {
+    context.model = params.entropy;
+  }
+
+  // parameters recorded in the header of the stream
+  const parameters& stream_parameters() const {
+    return params;
+  }
+
+  iterator begin() {
+    if (!started) {
+      started = true;
+      next_block();
+    }
+    return iterator {this};
+  }
+
+  std::default_sentinel_t end() const {
+    return std::default_sentinel;
+  }
+};
+
+}    // namespace stream
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "COMPRESS.hpp"
+#include "UTIL.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <numeric>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Survey of the rule space: every rule and section size compressed over a
+// corpus, so rules are picked from data instead of intuition. The
+// cacompress_survey tool in survey/ writes the rows as CSV.
+
+namespace survey {
+
+struct options {
+  std::vector<uint8_t> rules;    // empty for all 256
+  std::vector<size_t>  section_sizes {impl::compress::dispatch_section_sizes
+                                       .begin(),
+                                     impl::compress::dispatch_section_sizes
+                                     .end()};
+  uint8_t depth   = impl::compress::max_count;
+  size_t  threads = 0;    // 0 for hardware concurrency
+};
+
+struct row {
+  uint8_t rule            = 0;
+  size_t  section_size    = 0;
+  size_t  input_size      = 0;
+  size_t  compressed_size = 0;
+  double  mean_count      = 0.0;    // chosen SOCA count per section
+  double  encode_mbps     = 0.0;    // runtime compress throughput
+  double  decode_mbps     = 0.0;    // runtime decompress throughput
+};
+
+}    // namespace survey
+
+namespace impl::survey {
+
+inline double mbps(size_t size, double seconds) {
+  return seconds > 0.0 ? static_cast<double>(size) / seconds / 1'000'000.0
+                       : 0.0;
+}
+
+// row of one rule and section size, false if the corpus does not round trip
+inline bool measure(const std::vector<uint8_t>& corpus,
+                    uint8_t                     depth,
+                    ::survey::row&              result) {
+  compression_context   compress_context;
+  decompression_context decompress_context;
+
+  std::vector<uint8_t> compressed;
+  std::vector<uint8_t> decompressed;
+  compressed.reserve(corpus.size());
+  decompressed.reserve(corpus.size());
+
+  const auto encode_start = std::chrono::steady_clock::now();
+  ::compress(corpus.begin(),
+             corpus.end(),
+             std::back_inserter(compressed),
+             compress_context,
+             result.rule,
+             result.section_size,
+             depth);
+  const auto encode_stop = std::chrono::steady_clock::now();
+
+  const auto decode_start = std::chrono::steady_clock::now();
+  ::decompress(compressed.begin(),
+               compressed.end(),
+               std::back_inserter(decompressed),
+               decompress_context,
+               result.rule,
+               result.section_size);
+  const auto decode_stop = std::chrono::steady_clock::now();
+
+  // runs are not stepped, they count as 0
+  const auto& counts = compress_context.soca_counts;
+  const auto  generations = std::accumulate(
+  counts.begin(), counts.end(), size_t {0}, [](size_t sum, uint8_t count) {
+    return count == impl::compress::run_count ? sum : sum + count;
+  });
+
+  result.input_size      = corpus.size();
+  result.compressed_size = compressed.size();
+  result.mean_count =
+  counts.empty() ? 0.0
+                 : static_cast<double>(generations) /
+                   static_cast<double>(counts.size());
+  result.encode_mbps = mbps(
+  corpus.size(),
+  std::chrono::duration<double>(encode_stop - encode_start).count());
+  result.decode_mbps = mbps(
+  corpus.size(),
+  std::chrono::duration<double>(decode_stop - decode_start).count());
+
+  return decompressed == corpus;
+}
+
+}    // namespace impl::survey
+
+namespace survey {
+
+/***
+ * @brief compresses and decompresses the input with every rule and section
+ * size of opts, one row each, ordered by rule then section size
+ * @note the pairs run as independent tasks on up to opts.threads workers
+ * @warning throughput is measured with all workers busy, compare only rows
+ * of the same run
+ * @throws std::invalid_argument for a section size of 0 or depth above
+ * impl::compress::max_count
+ * @throws std::runtime_error if a pair fails to round trip
+ ***/
+template<typename ItrIn>
+requires std::random_access_iterator<ItrIn>
+std::vector<row> run(ItrIn begin, ItrIn end, const options& opts) {
+  // checked up front, the workers must not throw
+  if (std::find(opts.section_sizes.begin(), opts.section_sizes.end(), 0) !=
+      opts.section_sizes.end()) {
+    throw std::invalid_argument("section_size must be positive");
+  }
+  if (opts.depth > impl::compress::max_count) {
+    throw std::invalid_argument("depth must not exceed max_count");
+  }
+
+  const std::vector<uint8_t> corpus(begin, end);
+
+  std::vector<uint8_t> rules = opts.rules;
+  if (rules.empty()) {
+    rules.resize(256);
+    std::iota(rules.begin(), rules.end(), uint8_t {0});
+  }
+
+  std::vector<row> rows;
+  for (const uint8_t rule : rules) {
+    for (const size_t section_size : opts.section_sizes) {
+      rows.push_back({.rule = rule, .section_size = section_size});
+    }
+  }
+
+  std::vector<uint8_t> verified(rows.size());
+  util::parallel_for(rows.size(), opts.threads, [&](size_t idx) {
+    verified[idx] = impl::survey::measure(corpus, opts.depth, rows[idx]);
+  });
+
+  const auto failed = std::find(verified.begin(), verified.end(), 0);
+  if (failed != verified.end()) {
+    const row& bad = rows[std::distance(verified.begin(), failed)];
+    throw std::runtime_error(
+    "rule " + std::to_string(bad.rule) + " section size " +
+    std::to_string(bad.section_size) + " does not round trip");
+  }
+
+  return rows;
+}
+
+// header line, then one line per row
+inline void write_csv(std::ostream& out, const std::vector<row>& rows) {
+  out << "rule,section_size,input_size,compressed_size,ratio,mean_count,"
+         "encode_mbps,decode_mbps\n";
+  for (const row& entry : rows) {
+    const double ratio =
+    entry.compressed_size == 0
+    ? 0.0
+    : static_cast<double>(entry.input_size) /
+      static_cast<double>(entry.compressed_size);
+
+    out << static_cast<unsigned>(entry.rule) << ',' << entry.section_size
+        << ',' << entry.input_size << ',' << entry.compressed_size << ','
+        << ratio << ',' << entry.mean_count << ',' << entry.encode_mbps << ','
+        << entry.decode_mbps << '\n';
+  }
+}
+
+}    // namespace survey
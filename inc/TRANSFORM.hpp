@@ -0,0 +1,350 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Reversible in-place stages ahead of the SOCA search. Every stage streams:
+// it carries what it needs of earlier bytes in its state, so a pipeline runs
+// all of its stages over one cache sized tile before the next, one pass over
+// the data however many stages. Stages compose at compile time through
+// pipeline<Stages...> or at run time through chain, which the stream header
+// records, see STREAM.hpp.
+
+namespace impl::transform {
+
+constexpr size_t tile_size = 16 * 1024;
+
+// bytes per vector step of the lag kernels, locals of this size vectorize
+constexpr size_t lane_count = 32;
+
+struct subtract {
+  static constexpr uint8_t apply(uint8_t value, uint8_t previous) {
+    return static_cast<uint8_t>(value - previous);
+  }
+
+  static constexpr uint8_t revert(uint8_t value, uint8_t previous) {
+    return static_cast<uint8_t>(value + previous);
+  }
+};
+
+struct exclusive_or {
+  static constexpr uint8_t apply(uint8_t value, uint8_t previous) {
+    return value ^ previous;
+  }
+
+  static constexpr uint8_t revert(uint8_t value, uint8_t previous) {
+    return value ^ previous;
+  }
+};
+
+/***
+ * @brief x[i] = Op(x[i], x[i - distance]), x[i - distance] of earlier tiles
+ * from the history, zero before the first byte
+ * @note apply walks the tile back to front in steps of lane_count: a step
+ * loads both operands before it stores, and the bytes it loads below the
+ * step are not yet written, so the kernel is free of loop carried
+ * dependencies for any distance. revert depends on its own output, it steps
+ * front to back lane_count at a time for distance >= lane_count, byte by
+ * byte below.
+ ***/
+template<typename Op>
+class lag {
+  size_t               distance;
+  std::vector<uint8_t> history;    // last distance bytes of earlier tiles
+  std::vector<uint8_t> tail;       // original end of the tile apply writes
+
+  // history after a tile whose original bytes are data
+  void remember(std::span<const uint8_t> data) {
+    if (data.size() >= distance) {
+      std::copy(data.end() - distance, data.end(), history.begin());
+      return;
+    }
+    std::copy(history.begin() + data.size(), history.end(), history.begin());
+    std::copy(data.begin(), data.end(), history.end() - data.size());
+  }
+
+public:
+  explicit lag(size_t distance): distance(distance), history(distance) {
+    if (distance == 0) {
+      throw std::invalid_argument("transform distance must be positive");
+    }
+  }
+
+  void reset() {
+    std::fill(history.begin(), history.end(), 0);
+  }
+
+  void apply(std::span<uint8_t> tile) {
+    const size_t size = tile.size();
+    const size_t head = std::min(distance, size);
+
+    tail.assign(tile.end() - head, tile.end());
+
+    size_t idx = size;
+    while (idx >= head + lane_count) {
+      idx -= lane_count;
+
+      std::array<uint8_t, lane_count> current;
+      std::array<uint8_t, lane_count> previous;
+      std::memcpy(current.data(), &tile[idx], lane_count);
+      std::memcpy(previous.data(), &tile[idx - distance], lane_count);
+      for (size_t lane = 0; lane < lane_count; ++lane) {
+        current[lane] = Op::apply(current[lane], previous[lane]);
+      }
+      std::memcpy(&tile[idx], current.data(), lane_count);
+    }
+    while (idx > head) {
+      --idx;
+      tile[idx] = Op::apply(tile[idx], tile[idx - distance]);
+    }
+    for (idx = 0; idx < head; ++idx) {
+      tile[idx] = Op::apply(tile[idx], history[idx]);
+    }
+
+    remember(tail);
+  }
+
+  void revert(std::span<uint8_t> tile) {
+    const size_t size = tile.size();
+    const size_t head = std::min(distance, size);
+
+    for (size_t idx = 0; idx < head; ++idx) {
+      tile[idx] = Op::revert(tile[idx], history[idx]);
+    }
+
+    size_t idx = head;
+    if (distance == 1) {    // carried in a register, not through memory
+      uint8_t previous = head == 0 ? 0 : tile[0];
+      for (; idx < size; ++idx) {
+        previous  = Op::revert(tile[idx], previous);
+        tile[idx] = previous;
+      }
+    } else if (distance >= lane_count) {
+      for (; idx + lane_count <= size; idx += lane_count) {
+        std::array<uint8_t, lane_count> current;
+        std::array<uint8_t, lane_count> previous;
+        std::memcpy(current.data(), &tile[idx], lane_count);
+        std::memcpy(previous.data(), &tile[idx - distance], lane_count);
+        for (size_t lane = 0; lane < lane_count; ++lane) {
+          current[lane] = Op::revert(current[lane], previous[lane]);
+        }
+        std::memcpy(&tile[idx], current.data(), lane_count);
+      }
+    }
+    for (; idx < size; ++idx) {
+      tile[idx] = Op::revert(tile[idx], tile[idx - distance]);
+    }
+
+    remember(tile);
+  }
+};
+
+template<typename Fn>
+void for_each_tile(std::span<uint8_t> data, Fn fn) {
+  for (size_t start = 0; start < data.size(); start += tile_size) {
+    fn(data.subspan(start, std::min(tile_size, data.size() - start)));
+  }
+}
+
+}    // namespace impl::transform
+
+namespace transform {
+
+// byte minus the byte before it
+class delta : public impl::transform::lag<impl::transform::subtract> {
+public:
+  delta(): lag(1) {
+  }
+};
+
+// byte minus the byte distance before it, the field of the previous record
+// for records distance bytes wide
+class stride_delta : public impl::transform::lag<impl::transform::subtract> {
+public:
+  explicit stride_delta(size_t distance): lag(distance) {
+  }
+};
+
+// byte xor the byte of the previous record, records width bytes wide
+class xor_record : public impl::transform::lag<impl::transform::exclusive_or> {
+public:
+  explicit xor_record(size_t width): lag(width) {
+  }
+};
+
+/***
+ * @brief byte replaced by its position in a list of recently seen bytes,
+ * which then moves to the front
+ * @note recurring bytes turn into small numbers, runs into zeros. The list
+ * is the state across tiles.
+ ***/
+class move_to_front {
+  std::array<uint8_t, 256> recent;
+
+public:
+  move_to_front() {
+    reset();
+  }
+
+  void reset() {
+    std::iota(recent.begin(), recent.end(), uint8_t {0});
+  }
+
+  void apply(std::span<uint8_t> tile) {
+    for (uint8_t& byte : tile) {
+      const uint8_t value = byte;
+
+      const auto position = static_cast<uint8_t>(
+      static_cast<const uint8_t*>(std::memchr(recent.data(), value, 256)) -
+      recent.data());
+      std::copy_backward(recent.begin(),
+                         recent.begin() + position,
+                         recent.begin() + position + 1);
+      recent[0] = value;
+      byte      = position;
+    }
+  }
+
+  void revert(std::span<uint8_t> tile) {
+    for (uint8_t& byte : tile) {
+      const uint8_t position = byte;
+      const uint8_t value    = recent[position];
+
+      std::copy_backward(recent.begin(),
+                         recent.begin() + position,
+                         recent.begin() + position + 1);
+      recent[0] = value;
+      byte      = value;
+    }
+  }
+};
+
+/***
+ * @brief stages composed at compile time, applied first to last and reverted
+ * last to first
+ * @note apply and revert each transform all of data, the stages start from
+ * their initial state
+ ***/
+template<typename... Stages>
+class pipeline {
+  std::tuple<Stages...> stages;
+
+  template<size_t... idx>
+  void revert_tile(std::span<uint8_t> tile, std::index_sequence<idx...>) {
+    (std::get<sizeof...(Stages) - 1 - idx>(stages).revert(tile), ...);
+  }
+
+public:
+  explicit pipeline(Stages... each): stages(std::move(each)...) {
+  }
+
+  void apply(std::span<uint8_t> data) {
+    std::apply([](auto&... stage) { (stage.reset(), ...); }, stages);
+    impl::transform::for_each_tile(data, [&](std::span<uint8_t> tile) {
+      std::apply([&](auto&... stage) { (stage.apply(tile), ...); }, stages);
+    });
+  }
+
+  void revert(std::span<uint8_t> data) {
+    std::apply([](auto&... stage) { (stage.reset(), ...); }, stages);
+    impl::transform::for_each_tile(data, [&](std::span<uint8_t> tile) {
+      revert_tile(tile, std::index_sequence_for<Stages...> {});
+    });
+  }
+};
+
+// stage identifiers of the stream format, values are stored
+enum class kind : uint8_t {
+  delta         = 1,
+  stride_delta  = 2,
+  xor_record    = 3,
+  move_to_front = 4,
+};
+
+// a stage of a run time chain, distance is the stride of stride_delta and
+// the record width of xor_record
+struct stage {
+  kind   type;
+  size_t distance = 1;
+
+  bool operator==(const stage&) const = default;
+};
+
+constexpr size_t max_stages = 8;
+
+/***
+ * @brief stages composed at run time, as pipeline
+ * @throws std::invalid_argument for more than max_stages stages, unknown
+ * kinds or distance 0
+ ***/
+class chain {
+  using any_stage =
+  std::variant<delta, stride_delta, xor_record, move_to_front>;
+
+  std::vector<any_stage> stages;
+
+  static any_stage make(const stage& description) {
+    switch (description.type) {
+      case kind::delta:
+        return delta {};
+      case kind::stride_delta:
+        return stride_delta {description.distance};
+      case kind::xor_record:
+        return xor_record {description.distance};
+      case kind::move_to_front:
+        return move_to_front {};
+    }
+    throw std::invalid_argument("unknown transform");
+  }
+
+  void reset() {
+    for (auto& any : stages) {
+      std::visit([](auto& stage) { stage.reset(); }, any);
+    }
+  }
+
+public:
+  explicit chain(std::span<const stage> descriptions) {
+    if (descriptions.size() > max_stages) {
+      throw std::invalid_argument("too many transforms");
+    }
+    stages.reserve(descriptions.size());
+    for (const auto& description : descriptions) {
+      stages.push_back(make(description));
+    }
+  }
+
+  bool empty() const {
+    return stages.empty();
+  }
+
+  void apply(std::span<uint8_t> data) {
+    reset();
+    impl::transform::for_each_tile(data, [&](std::span<uint8_t> tile) {
+      for (auto& any : stages) {
+        std::visit([&](auto& stage) { stage.apply(tile); }, any);
+      }
+    });
+  }
+
+  void revert(std::span<uint8_t> data) {
+    reset();
+    impl::transform::for_each_tile(data, [&](std::span<uint8_t> tile) {
+      for (auto any = stages.rbegin(); any != stages.rend(); ++any) {
+        std::visit([&](auto& stage) { stage.revert(tile); }, *any);
+      }
+    });
+  }
+};
+
+}    // namespace transform
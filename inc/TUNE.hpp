@@ -0,0 +1,409 @@
+#pragma once
+
+#include "COMPRESS.hpp"
+#include "DICTIONARY.hpp"
+#include "STREAM.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <istream>
+#include <iterator>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tune {
+
+// max ratio among parameters compressing at min_mbps or faster, 0 for any
+struct goal {
+  double min_mbps = 0.0;
+};
+
+// candidates and sampling of the search
+struct search_space {
+  std::vector<uint8_t> rules;    // empty for all 256
+  std::vector<size_t>  section_sizes {impl::compress::dispatch_section_sizes
+                                       .begin(),
+                                     impl::compress::dispatch_section_sizes
+                                     .end()};
+  std::vector<uint8_t> depths {8, 16, impl::compress::max_count};
+
+  size_t finalists         = 8;       // rules kept after screening
+  size_t sample_blocks     = 8;       // blocks taken evenly across the input
+  size_t sample_block_size = 4096;    // bytes per sample block
+  size_t threads           = 0;       // 0 for hardware concurrency
+};
+
+struct result {
+  stream::parameters chosen;
+  double             ratio;    // sample size / compressed sample size
+  double             mbps;     // compression throughput on the sample
+};
+
+}    // namespace tune
+
+namespace impl::tune {
+
+struct trial {
+  ::stream::parameters params;
+  size_t               compressed_size;
+  double               seconds;
+};
+
+/***
+ * @brief checked up front, the workers must not throw
+ * @throws std::invalid_argument for a section size that is odd or below 4,
+ * or a depth above impl::compress::max_count
+ ***/
+inline void check_space(const ::tune::search_space& space) {
+  for (const size_t section_size : space.section_sizes) {
+    if (!impl::compress::transformable(static_cast<ptrdiff_t>(section_size))) {
+      throw std::invalid_argument("section sizes must be even and at least 4");
+    }
+  }
+  for (const uint8_t depth : space.depths) {
+    if (depth > impl::compress::max_count) {
+      throw std::invalid_argument("depth must not exceed max_count");
+    }
+  }
+}
+
+// sample_blocks blocks of sample_block_size spread evenly over the input
+template<typename ItrIn>
+std::vector<uint8_t> sample(ItrIn                         begin,
+                            ItrIn                         end,
+                            const ::tune::search_space& space) {
+  const auto size  = static_cast<size_t>(std::distance(begin, end));
+  const auto total = space.sample_blocks * space.sample_block_size;
+
+  if (size <= total || space.sample_blocks == 0) {
+    return {begin, end};
+  }
+
+  std::vector<uint8_t> result;
+  result.reserve(total);
+
+  const size_t stride = size / space.sample_blocks;
+  for (size_t block = 0; block < space.sample_blocks; ++block) {
+    const auto block_begin = begin + block * stride;
+    result.insert(result.end(),
+                  block_begin,
+                  block_begin + std::min(space.sample_block_size, stride));
+  }
+
+  return result;
+}
+
+inline trial evaluate(const std::vector<uint8_t>& data,
+                      ::stream::parameters        params) {
+  std::vector<uint8_t> compressed;
+  compressed.reserve(data.size());
+
+  const auto start = std::chrono::steady_clock::now();
+  ::compress(data.begin(),
+             data.end(),
+             std::back_inserter(compressed),
+             params.rule,
+             params.section_size,
+             params.depth);
+  const auto stop = std::chrono::steady_clock::now();
+
+  return {.params          = params,
+          .compressed_size = compressed.size(),
+          .seconds = std::chrono::duration<double>(stop - start).count()};
+}
+
+inline std::vector<trial> evaluate_all(
+const std::vector<uint8_t>&              data,
+const std::vector<::stream::parameters>& candidates,
+size_t                                   threads) {
+  std::vector<trial> trials(candidates.size());
+  util::parallel_for(candidates.size(), threads, [&](size_t idx) {
+    trials[idx] = evaluate(data, candidates[idx]);
+  });
+  return trials;
+}
+
+// byte frequencies of the woven sections of sample, as compress() encodes them
+inline void count_woven(const std::vector<uint8_t>& sample,
+                        const ::stream::parameters& params,
+                        compression_context&        context,
+                        impl::order1::frequencies&  freq) {
+  if (sample.empty()) {
+    return;
+  }
+
+  impl::compress::with_kernels(
+  params.rule, params.section_size, [&](auto kernels) {
+    impl::compress::search_sections(sample.begin(),
+                                    sample.end(),
+                                    params.section_size,
+                                    kernels,
+                                    params.depth,
+                                    context);
+  });
+
+  impl::compress::with_woven(
+  params.section_size, context, [&](auto woven_begin, auto woven_end) {
+    for (auto itr = woven_begin; itr != woven_end; ++itr) {
+      ++freq[static_cast<uint8_t>(*itr)];
+    }
+  });
+}
+
+inline double mbps(size_t size, const trial& trial) {
+  return trial.seconds > 0.0
+         ? static_cast<double>(size) / trial.seconds / 1'000'000.0
+         : 0.0;
+}
+
+}    // namespace impl::tune
+
+namespace tune {
+
+/***
+ * @brief picks rule, section size and depth for the input
+ * @note rules are first screened on a quarter of the sample at the largest
+ * depth and a middle section size, the finalists are then tried with every
+ * section size and depth of the space in parallel
+ * @warning throughput is measured with all workers busy, compare only
+ * between results of the same machine and thread count
+ * @throws std::invalid_argument for a section size of the space that is odd
+ * or below 4, or a depth above impl::compress::max_count
+ ***/
+template<typename ItrIn>
+requires std::random_access_iterator<ItrIn>
+result tune(ItrIn               begin,
+            ItrIn               end,
+            const goal&         goal,
+            const search_space& space) {
+  impl::tune::check_space(space);
+
+  const auto data = impl::tune::sample(begin, end, space);
+
+  stream::parameters base {};
+  if (!space.depths.empty()) {
+    base.depth = *std::max_element(space.depths.begin(), space.depths.end());
+  }
+  if (!space.section_sizes.empty()) {
+    base.section_size = space.section_sizes[space.section_sizes.size() / 2];
+  }
+
+  if (data.empty()) {
+    return {.chosen = base, .ratio = 1.0, .mbps = 0.0};
+  }
+
+  std::vector<uint8_t> rules = space.rules;
+  if (rules.empty()) {
+    rules.resize(256);
+    std::iota(rules.begin(), rules.end(), uint8_t {0});
+  }
+
+  // screening
+  if (rules.size() > space.finalists) {
+    const std::vector<uint8_t> screen_data(
+    data.begin(),
+    data.begin() + std::max<ptrdiff_t>(std::ssize(data) / 4, 1));
+
+    std::vector<stream::parameters> candidates;
+    for (const uint8_t rule : rules) {
+      candidates.push_back(base);
+      candidates.back().rule = rule;
+    }
+
+    auto trials =
+    impl::tune::evaluate_all(screen_data, candidates, space.threads);
+    std::stable_sort(trials.begin(),
+                     trials.end(),
+                     [](const auto& lhs, const auto& rhs) {
+      return lhs.compressed_size < rhs.compressed_size;
+    });
+
+    rules.clear();
+    for (size_t idx = 0; idx < space.finalists; ++idx) {
+      rules.push_back(trials[idx].params.rule);
+    }
+  }
+
+  // full search over the finalists
+  std::vector<stream::parameters> candidates;
+  for (const uint8_t rule : rules) {
+    for (const size_t section_size : space.section_sizes) {
+      for (const uint8_t depth : space.depths) {
+        candidates.push_back(base);
+        candidates.back().rule         = rule;
+        candidates.back().section_size = section_size;
+        candidates.back().depth        = depth;
+      }
+    }
+  }
+  if (candidates.empty()) {
+    candidates.push_back(base);
+  }
+
+  const auto trials =
+  impl::tune::evaluate_all(data, candidates, space.threads);
+
+  const auto meets_goal = [&](const impl::tune::trial& trial) {
+    return impl::tune::mbps(data.size(), trial) >= goal.min_mbps;
+  };
+
+  const impl::tune::trial* best = nullptr;
+  for (const auto& trial : trials) {
+    if (!meets_goal(trial)) {
+      continue;
+    }
+    if (best == nullptr || trial.compressed_size < best->compressed_size ||
+        (trial.compressed_size == best->compressed_size &&
+         trial.seconds < best->seconds)) {
+      best = &trial;
+    }
+  }
+
+  // nothing is fast enough, settle for the fastest
+  if (best == nullptr) {
+    best = &*std::min_element(trials.begin(),
+                              trials.end(),
+                              [](const auto& lhs, const auto& rhs) {
+      return lhs.seconds < rhs.seconds;
+    });
+  }
+
+  return {.chosen = best->params,
+          .ratio  = static_cast<double>(data.size()) /
+                   static_cast<double>(best->compressed_size),
+          .mbps = impl::tune::mbps(data.size(), *best)};
+}
+
+/***
+ * @brief tuning results per data class and goal
+ * @note save/load use one line per entry:
+ * "data class" min_mbps rule section_size depth ratio mbps
+ ***/
+class cache {
+  std::map<std::pair<std::string, double>, result> entries;
+
+public:
+  std::optional<result> find(const std::string& data_class,
+                             const goal&        goal) const {
+    const auto found = entries.find({data_class, goal.min_mbps});
+    if (found == entries.end()) {
+      return std::nullopt;
+    }
+    return found->second;
+  }
+
+  void insert(const std::string& data_class,
+              const goal&        goal,
+              const result&      tuned) {
+    entries.insert_or_assign({data_class, goal.min_mbps}, tuned);
+  }
+
+  void save(std::ostream& out) const {
+    for (const auto& [key, entry] : entries) {
+      out << std::quoted(key.first) << ' ' << key.second << ' '
+          << static_cast<unsigned>(entry.chosen.rule) << ' '
+          << entry.chosen.section_size << ' '
+          << static_cast<unsigned>(entry.chosen.depth) << ' ' << entry.ratio
+          << ' ' << entry.mbps << '\n';
+    }
+  }
+
+  // entries read are added to the cache, reading stops at the first bad line
+  void load(std::istream& in) {
+    std::string data_class;
+    double      min_mbps = 0.0;
+    unsigned    rule     = 0;
+    unsigned    depth    = 0;
+    result      entry {};
+
+    while (in >> std::quoted(data_class) >> min_mbps >> rule >>
+           entry.chosen.section_size >> depth >> entry.ratio >> entry.mbps) {
+      if (rule > 255 || depth > impl::compress::max_count ||
+          entry.chosen.section_size == 0) {
+        return;
+      }
+      entry.chosen.rule  = static_cast<uint8_t>(rule);
+      entry.chosen.depth = static_cast<uint8_t>(depth);
+      entries.insert_or_assign({data_class, min_mbps}, entry);
+    }
+  }
+};
+
+// tune() unless the cache already holds a result for data_class and goal
+template<typename ItrIn>
+requires std::random_access_iterator<ItrIn>
+result tune(ItrIn               begin,
+            ItrIn               end,
+            const goal&         goal,
+            const search_space& space,
+            cache&              cache,
+            const std::string&  data_class) {
+  if (const auto cached = cache.find(data_class, goal)) {
+    return *cached;
+  }
+
+  const result tuned = tune(begin, end, goal, space);
+  cache.insert(data_class, goal, tuned);
+  return tuned;
+}
+
+/***
+ * @brief dictionary table trained on samples of the messages it will code
+ * @note the rule, section size and depth are tuned on the concatenated
+ * samples, the code is then built from the SOCA output of every sample.
+ * Every byte keeps a code, so messages unlike the samples still compress.
+ * @throws std::invalid_argument for a section size of the space that is odd
+ * or below 4, or a depth above impl::compress::max_count
+ ***/
+inline dictionary::table train(
+const std::vector<std::vector<uint8_t>>& samples,
+uint32_t                                 id,
+const search_space&                      space = {}) {
+  impl::tune::check_space(space);
+
+  std::vector<uint8_t> joined;
+  for (const auto& sample : samples) {
+    joined.insert(joined.end(), sample.begin(), sample.end());
+  }
+
+  const stream::parameters chosen =
+  tune(joined.begin(), joined.end(), goal {}, space).chosen;
+
+  compression_context       context;
+  impl::order1::frequencies freq;
+  std::fill(freq.begin(), freq.end(), 1);
+  for (const auto& sample : samples) {
+    impl::tune::count_woven(sample, chosen, context, freq);
+  }
+
+  impl::order1::bit_lengths lengths {};
+  impl::order1::code_lengths(freq, context.order1_entropy.tree, lengths);
+
+  return dictionary::make_table(
+  id, chosen.rule, chosen.section_size, chosen.depth, lengths);
+}
+
+// stream::compress with tuned parameters, recorded in the stream header
+template<typename ItrIn, typename ItrOut>
+requires std::random_access_iterator<ItrIn>
+ItrOut compress(ItrIn               begin,
+                ItrIn               end,
+                ItrOut              out,
+                const goal&         goal,
+                const search_space& space = {}) {
+  return stream::compress(begin,
+                          end,
+                          out,
+                          tune(begin, end, goal, space).chosen);
+}
+
+}    // namespace tune
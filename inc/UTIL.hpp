@@ -1,10 +1,20 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <bitset>
+#include <cstddef>
 #include <cstdint>
 #include <iterator>
 #include <cmath>
 #include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 namespace util {
 
@@ -89,15 +99,265 @@ public:
   }
 };
 
+// Shannon bound in bits for coding the histogram [begin, end), empty bins
+// skipped
 template <typename Itr>
 constexpr double calculate_entropy(Itr begin, Itr end) {
-  const size_t size = std::distance(begin, end);
+  double total = 0.0;
+  for (auto itr = begin; itr != end; ++itr) {
+    total += static_cast<double>(*itr);
+  }
 
   double result = 0.0;
   for (auto itr = begin; itr != end; ++itr) {
-    result += -std::log2(static_cast<double>(*itr) / size);
+    if (*itr != 0) {
+      const auto freq  = static_cast<double>(*itr);
+      result          += freq * std::log2(total / freq);
+    }
   }
   return result;
 }
 
-}    // namespace util
\ No newline at end of file
+/***
+ * @brief adds the byte counts of [begin, end) to counts
+ * @note random access input is counted into four interleaved tables, so runs
+ * of one byte value do not serialize on a single counter, then merged
+ ***/
+template<typename Itr>
+void count_bytes(Itr begin, Itr end, std::array<size_t, 256>& counts) {
+  if constexpr (std::random_access_iterator<Itr>) {
+    // below this the table setup and merge cost more than they save
+    constexpr ptrdiff_t min_tables = 1024;
+    // chunks keep the 32 bit counters from overflowing
+    constexpr ptrdiff_t chunk = ptrdiff_t {1} << 30;
+
+    while (end - begin >= min_tables) {
+      const auto chunk_end = begin + std::min(end - begin, chunk);
+
+      std::array<std::array<uint32_t, 256>, 4> tables {};
+
+      auto itr = begin;
+      for (; chunk_end - itr >= 4; itr += 4) {
+        ++tables[0][static_cast<uint8_t>(itr[0])];
+        ++tables[1][static_cast<uint8_t>(itr[1])];
+        ++tables[2][static_cast<uint8_t>(itr[2])];
+        ++tables[3][static_cast<uint8_t>(itr[3])];
+      }
+      for (; itr != chunk_end; ++itr) {
+        ++tables[0][static_cast<uint8_t>(*itr)];
+      }
+
+      // independent lanes, vectorized by the compiler
+      for (size_t byte = 0; byte < 256; ++byte) {
+        counts[byte] += size_t {tables[0][byte]} + tables[1][byte] +
+                        tables[2][byte] + tables[3][byte];
+      }
+
+      begin = chunk_end;
+    }
+  }
+
+  for (auto itr = begin; itr != end; ++itr) {
+    ++counts[static_cast<uint8_t>(*itr)];
+  }
+}
+
+/***
+ * @brief byte histogram with its Shannon bound kept up to date
+ * @note holds sum(f * log2 f) in fixed point per bin. Updates only mark bins
+ * dirty and entropy() refreshes those, so a search step touching a few bins
+ * costs a few log2 instead of one per bin, and equal histograms always give
+ * bit identical bounds.
+ ***/
+class histogram {
+  static constexpr double fraction = 1 << 24;    // fixed point of weights
+
+  std::array<size_t, 256>  counts {};
+  std::array<int64_t, 256> weights {};    // f * log2 f * fraction
+  std::array<uint64_t, 4>  dirty {};      // bins whose weight is stale
+  int64_t                  weight_sum {0};
+  size_t                   total {0};
+
+  void mark(uint8_t byte) {
+    dirty[byte >> 6] |= uint64_t {1} << (byte & 63);
+  }
+
+  void refresh() {
+    for (size_t word = 0; word < dirty.size(); ++word) {
+      while (dirty[word] != 0) {
+        const auto byte =
+        static_cast<uint8_t>(word * 64 + std::countr_zero(dirty[word]));
+        dirty[word] &= dirty[word] - 1;
+
+        const auto    freq   = static_cast<double>(counts[byte]);
+        const int64_t weight = counts[byte] > 1
+                               ? std::llround(freq * std::log2(freq) * fraction)
+                               : 0;
+        weight_sum           += weight - weights[byte];
+        weights[byte]         = weight;
+      }
+    }
+  }
+
+public:
+  template<typename Itr>
+  void add(Itr begin, Itr end) {
+    std::array<size_t, 256> added {};
+    count_bytes(begin, end, added);
+    for (size_t byte = 0; byte < 256; ++byte) {
+      if (added[byte] != 0) {
+        counts[byte] += added[byte];
+        total        += added[byte];
+        mark(static_cast<uint8_t>(byte));
+      }
+    }
+  }
+
+  void increment(uint8_t byte) {
+    ++counts[byte];
+    ++total;
+    mark(byte);
+  }
+
+  void decrement(uint8_t byte) {
+    --counts[byte];
+    --total;
+    mark(byte);
+  }
+
+  void decrement(uint8_t byte, size_t amount) {
+    counts[byte] -= amount;
+    total        -= amount;
+    mark(byte);
+  }
+
+  // fused update for a byte changed in place
+  void replace(uint8_t before, uint8_t after) {
+    if (before != after) {
+      --counts[before];
+      ++counts[after];
+      mark(before);
+      mark(after);
+    }
+  }
+
+  // replace() for each byte of [before_begin, before_end) and after
+  template<typename ItrBefore, typename ItrAfter>
+  void replace(ItrBefore before_begin, ItrBefore before_end, ItrAfter after) {
+    for (auto itr = before_begin; itr != before_end; ++itr, ++after) {
+      replace(*itr, *after);
+    }
+  }
+
+  // same value as calculate_entropy over the counts
+  double entropy() {
+    refresh();
+    if (total == 0) {
+      return 0.0;
+    }
+    const auto size = static_cast<double>(total);
+    return size * std::log2(size) - static_cast<double>(weight_sum) / fraction;
+  }
+
+  size_t operator[](uint8_t byte) const {
+    return counts[byte];
+  }
+
+  size_t size() const {
+    return total;
+  }
+
+  const std::array<size_t, 256>& bins() const {
+    return counts;
+  }
+};
+
+// LEB128, 7 bits per byte, high bit set on all but the last byte
+template<typename Itr>
+constexpr Itr write_varint(Itr output_iterator, uint64_t value) {
+  while (value >= 0x80) {
+    *output_iterator++   = static_cast<uint8_t>(value | 0x80);
+    value              >>= 7;
+  }
+  *output_iterator++ = static_cast<uint8_t>(value);
+  return output_iterator;
+}
+
+// @throws std::runtime_error on truncated or overlong input
+template<typename Itr>
+constexpr uint64_t read_varint(Itr& input_iterator, Itr end) {
+  uint64_t result = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (input_iterator == end) {
+      throw std::runtime_error("truncated varint");
+    }
+
+    const uint8_t byte  = *input_iterator++;
+    result             |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+    if ((byte & 0x80) == 0) {
+      return result;
+    }
+  }
+  throw std::runtime_error("overlong varint");
+}
+
+/***
+ * @brief fn(idx) for idx in [0, count) on up to threads workers, 0 for all
+ * cores
+ * @throws the first exception fn throws, once every worker has joined. No
+ * further indices are handed out after it.
+ * @throws std::system_error if a worker cannot be started, once the started
+ * ones have joined
+ ***/
+template<typename Fn>
+void parallel_for(size_t count, size_t threads, Fn fn) {
+  if (threads == 0) {
+    threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  }
+  threads = std::min(threads, count);
+
+  std::atomic<size_t>      next {0};
+  std::exception_ptr       error;
+  std::mutex               error_mutex;
+  std::vector<std::thread> workers;
+  workers.reserve(threads);
+
+  const auto join = [&] {
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  };
+
+  // a worker that fails to start stops the others, which must be joined
+  // before the vector destroys them
+  try {
+    for (size_t worker = 0; worker < threads; ++worker) {
+      workers.emplace_back([&] {
+        for (size_t idx = next++; idx < count; idx = next++) {
+          try {
+            fn(idx);
+          } catch (...) {
+            const std::lock_guard lock {error_mutex};
+            if (!error) {
+              error = std::current_exception();
+            }
+            next = count;
+          }
+        }
+      });
+    }
+  } catch (...) {
+    next = count;
+    join();
+    throw;
+  }
+
+  join();
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+}    // namespace util
@@ -1,18 +1,23 @@
 #include "COMPRESS.hpp"
 #include "HUFFMAN.hpp"
 #include "SOCA.hpp"
+#include "STATS.hpp"
+#include "STREAM.hpp"
 #include "UTIL.hpp"
 #include <fmt/core.h>
 
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <bitset>
-#include <chrono>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <random>
+#include <string_view>
 #include <raylib.h>
+#include <utility>
 #include <vector>
 
 // UTILS v
@@ -47,86 +52,319 @@ bool verify_array(const auto& arr1, const auto& arr2) {
   return true;
 }
 
-template<size_t size>
-void display_array(const std::array<uint8_t, size>& arr, int height_pos) {
-  int width_pos = 0;
-  for (const auto& elem : arr) {
-    if (elem & 1) {
-      DrawRectangle(width_pos, height_pos, 10, 10, BLACK);
+std::vector<uint8_t> create_vector(size_t size) {
+  std::vector<uint8_t> vec(size);
+
+  std::mt19937                  gen {std::random_device {}()};
+  std::uniform_int_distribution dist {0, 255};
+
+  for (auto& elem : vec) {
+    elem = static_cast<uint8_t>(dist(gen));
+  }
+
+  return vec;
+}
+
+// UTILS ^
+// VISUAL v
+
+constexpr int    visual_generations = 50;     // forward, then reverse
+constexpr int    visual_width       = 1280;
+constexpr int    cell_height        = 10;     // screen rows per generation
+constexpr int    trace_height       = 200;    // band of the traces below
+constexpr size_t visual_section     = 40;     // section size of the traces
+
+/***
+ * @brief space-time diagram of the 2 iteration SOCA over the whole input
+ * @note one row of input bits per generation, bit 0 of a byte leftmost.
+ * The first half of the rows runs forward, the second half reverses back to
+ * the input. Only computed when the rule or the input change.
+ ***/
+class diagram {
+  size_t               row_bytes = 0;
+  std::vector<uint8_t> rows;
+
+public:
+  void compute(const std::vector<uint8_t>& input, uint8_t rule) {
+    row_bytes = input.size();
+    rows.resize(visual_generations * row_bytes);
+
+    std::vector<uint8_t> state = input;
+
+    auto row = rows.begin();
+    for (int gen = 0; gen < visual_generations / 2; ++gen) {
+      row = std::copy(state.begin(), state.end(), row);
+      soca::forward_front(state.begin(), state.end(), rule);
+      soca::forward_back(state.begin(), state.end(), rule);
     }
-    width_pos += 10;
+    for (int gen = visual_generations / 2; gen < visual_generations; ++gen) {
+      soca::reverse_back(state.begin(), state.end(), rule);
+      soca::reverse_front(state.begin(), state.end(), rule);
+      row = std::copy(state.begin(), state.end(), row);
+    }
+  }
+
+  size_t columns() const {
+    return row_bytes * 8;
+  }
+
+  // set bits of row among the columns [first, last)
+  size_t count(int row, size_t first, size_t last) const {
+    const uint8_t* bytes  = rows.data() + row * row_bytes;
+    size_t         result = 0;
+
+    for (; first < last && first % 8 != 0; ++first) {
+      result += bytes[first / 8] >> first % 8 & 1;
+    }
+    for (; first + 8 <= last; first += 8) {
+      result += std::popcount(bytes[first / 8]);
+    }
+    for (; first < last; ++first) {
+      result += bytes[first / 8] >> first % 8 & 1;
+    }
+
+    return result;
+  }
+};
 
-    if (elem & 2) {
-      DrawRectangle(width_pos, height_pos, 10, 10, BLACK);
+// per section results of a real compress run over the input
+struct traces {
+  std::vector<uint8_t> counts;            // chosen SOCA count
+  std::vector<double>  entropy_before;    // bits per byte of the input
+  std::vector<double>  entropy_after;     // bits per byte after the search
+
+  void compute(const std::vector<uint8_t>& input, uint8_t rule) {
+    compression_context  context;
+    std::vector<uint8_t> compressed;
+    compress(input.begin(),
+             input.end(),
+             std::back_inserter(compressed),
+             context,
+             rule,
+             visual_section);
+
+    counts.assign(context.soca_counts.begin(), context.soca_counts.end());
+    entropy_before.clear();
+    entropy_after.clear();
+
+    const auto section_entropy = [](auto begin, auto end) {
+      std::array<size_t, 256> freq {};
+      for (auto itr = begin; itr != end; ++itr) {
+        ++freq[*itr];
+      }
+      return util::calculate_entropy(freq.begin(), freq.end()) /
+             static_cast<double>(std::distance(begin, end));
+    };
+
+    for (size_t start = 0; start < input.size(); start += visual_section) {
+      const size_t stop = std::min(start + visual_section, input.size());
+      entropy_before.push_back(
+      section_entropy(input.begin() + start, input.begin() + stop));
+      entropy_after.push_back(section_entropy(context.data.begin() + start,
+                                              context.data.begin() + stop));
     }
-    width_pos += 10;
+  }
+};
+
+// horizontal window over the diagram, in input bits
+struct view {
+  double first = 0.0;    // column at the left edge
+  double scale = 1.0;    // columns per screen pixel
+
+  void clamp(size_t columns) {
+    const double max_scale =
+    std::max(static_cast<double>(columns) / visual_width, 1.0 / cell_height);
+    scale = std::clamp(scale, 1.0 / cell_height, max_scale);
+
+    const double max_first =
+    std::max(static_cast<double>(columns) - visual_width * scale, 0.0);
+    first = std::clamp(first, 0.0, max_first);
+  }
+
+  // columns [first, last) under screen column x, at least one
+  std::pair<size_t, size_t> columns_of(int x, size_t columns) const {
+    const auto begin = static_cast<size_t>(first + x * scale);
+    const auto end   = static_cast<size_t>(first + (x + 1) * scale);
+    return {std::min(begin, columns),
+            std::min(std::max(end, begin + 1), columns)};
+  }
+};
 
-    if (elem & 4) {
-      DrawRectangle(width_pos, height_pos, 10, 10, BLACK);
+// grayscale texels of the view, one per screen column and generation,
+// darker the more of the covered bits are set
+void rasterize(const diagram&        space_time,
+               const view&           window,
+               std::vector<uint8_t>& pixels) {
+  const size_t columns = space_time.columns();
+  for (int x = 0; x < visual_width; ++x) {
+    const auto [first, last] = window.columns_of(x, columns);
+    for (int row = 0; row < visual_generations; ++row) {
+      uint8_t& pixel = pixels[row * visual_width + x];
+      if (first == last) {
+        pixel = 200;
+        continue;
+      }
+      const size_t set = space_time.count(row, first, last);
+      pixel = static_cast<uint8_t>(255 - 255 * set / (last - first));
     }
-    width_pos += 10;
+  }
+}
 
-    if (elem & 8) {
-      DrawRectangle(width_pos, height_pos, 10, 10, BLACK);
+// line strip of a value per section, full_scale at the top of the band,
+// sampled at every screen column
+template<typename Value>
+void trace_points(const std::vector<Value>& values,
+                  double                    full_scale,
+                  const view&               window,
+                  size_t                    columns,
+                  std::vector<Vector2>&     points) {
+  constexpr float band_top =
+  static_cast<float>(visual_generations * cell_height);
+
+  points.clear();
+  for (int x = 0; x < visual_width; ++x) {
+    const auto [first, last] = window.columns_of(x, columns);
+    if (first == last) {
+      break;
     }
-    width_pos += 10;
+    const size_t section = (first + last) / 2 / 8 / visual_section;
+    const double value =
+    values[std::min(section, values.size() - 1)] / full_scale;
+    points.push_back({static_cast<float>(x),
+                      band_top + static_cast<float>(trace_height) *
+                                 static_cast<float>(1.0 - value)});
+  }
+}
 
-    if (elem & 16) {
-      DrawRectangle(width_pos, height_pos, 10, 10, BLACK);
+/***
+ * @brief space-time viewer of input_size random bytes
+ * @note LEFT/RIGHT change the rule, R draws a new input, the mouse wheel
+ * zooms and dragging scrolls. The diagram is computed on rule or input
+ * change and the texture updated on view change only, a frame just draws it.
+ ***/
+void visualize(size_t input_size) {
+  InitWindow(visual_width,
+             visual_generations * cell_height + trace_height,
+             "SOCA Triple: 0");
+  SetTargetFPS(60);
+
+  std::vector<uint8_t> pixels(visual_width * visual_generations);
+
+  const Image image {.data    = pixels.data(),
+                     .width   = visual_width,
+                     .height  = visual_generations,
+                     .mipmaps = 1,
+                     .format  = PIXELFORMAT_UNCOMPRESSED_GRAYSCALE};
+  const Texture2D texture = LoadTextureFromImage(image);
+  SetTextureFilter(texture, TEXTURE_FILTER_POINT);
+
+  auto    input = create_vector(input_size + input_size % 2);
+  uint8_t rule  = 0;
+
+  diagram              space_time;
+  traces               compressed;
+  view                 window {.first = 0.0, .scale = 1.0};
+  std::vector<Vector2> count_points;
+  std::vector<Vector2> before_points;
+  std::vector<Vector2> after_points;
+
+  bool input_changed = true;
+  while (!WindowShouldClose()) {
+    bool view_changed = false;
+
+    if (IsKeyPressed(KEY_LEFT) && rule != 0) {
+      --rule;
+      input_changed = true;
+    }
+    if (IsKeyPressed(KEY_RIGHT) && rule != 255) {
+      ++rule;
+      input_changed = true;
+    }
+    if (IsKeyPressed(KEY_R)) {
+      input         = create_vector(input.size());
+      input_changed = true;
     }
-    width_pos += 10;
 
-    if (elem & 32) {
-      DrawRectangle(width_pos, height_pos, 10, 10, BLACK);
+    if (const float wheel = GetMouseWheelMove(); wheel != 0.0F) {
+      const double anchor = window.first + GetMousePosition().x * window.scale;
+      window.scale        *= std::pow(0.8, wheel);
+      window.first         = anchor - GetMousePosition().x * window.scale;
+      view_changed         = true;
+    }
+    if (IsMouseButtonDown(MOUSE_BUTTON_LEFT)) {
+      if (const float dx = GetMouseDelta().x; dx != 0.0F) {
+        window.first -= dx * window.scale;
+        view_changed  = true;
+      }
     }
-    width_pos += 10;
 
-    if (elem & 64) {
-      DrawRectangle(width_pos, height_pos, 10, 10, BLACK);
+    if (input_changed) {
+      space_time.compute(input, rule);
+      compressed.compute(input, rule);
+      SetWindowTitle(fmt::format("SOCA Triple: {}", rule).c_str());
+      view_changed = true;
     }
-    width_pos += 10;
 
-    if (elem & 128) {
-      DrawRectangle(width_pos, height_pos, 10, 10, BLACK);
+    if (view_changed) {
+      const size_t columns = space_time.columns();
+      window.clamp(columns);
+      rasterize(space_time, window, pixels);
+      UpdateTexture(texture, pixels.data());
+      trace_points(compressed.counts,
+                   impl::compress::max_count,
+                   window,
+                   columns,
+                   count_points);
+      trace_points(
+      compressed.entropy_before, 8.0, window, columns, before_points);
+      trace_points(
+      compressed.entropy_after, 8.0, window, columns, after_points);
     }
-    width_pos += 10;
-  }
-}
+    input_changed = false;
 
-// UTILS ^
-// SOCA v
+    BeginDrawing();
 
-template<size_t size>
-void soca_2itr_visual(std::array<uint8_t, size> arr, uint8_t rule, int itr) {
-  int height_pos = 0;
-  for (int i = 0; i < itr / 2; ++i) {
-    std::array<uint8_t, size / 2> arr_older {};
-    std::array<uint8_t, size / 2> arr_newer {};
-    std::copy(arr.begin(), arr.begin() + size / 2, arr_older.begin());
-    std::copy(arr.begin() + size / 2, arr.end(), arr_newer.begin());
-    display_array(arr_older, height_pos);
-    height_pos += 10;
-    display_array(arr_newer, height_pos);
-    height_pos += 10;
-    soca::forward_front(arr.begin(), arr.end(), rule);
-    soca::forward_back(arr.begin(), arr.end(), rule);
-  }
+    ClearBackground(WHITE);
 
-  for (int i = itr / 2; i < itr; ++i) {
-    soca::reverse_back(arr.begin(), arr.end(), rule);
-    soca::reverse_front(arr.begin(), arr.end(), rule);
-    std::array<uint8_t, size / 2> arr_older {};
-    std::array<uint8_t, size / 2> arr_newer {};
-    std::copy(arr.begin(), arr.begin() + size / 2, arr_older.begin());
-    std::copy(arr.begin() + size / 2, arr.end(), arr_newer.begin());
-    display_array(arr_newer, height_pos);
-    height_pos += 10;
-    display_array(arr_older, height_pos);
-    height_pos += 10;
+    DrawTexturePro(texture,
+                   {0, 0, visual_width, visual_generations},
+                   {0, 0, visual_width, visual_generations * cell_height},
+                   {0, 0},
+                   0.0F,
+                   WHITE);
+    DrawLine(0,
+             visual_generations / 2 * cell_height,
+             visual_width,
+             visual_generations / 2 * cell_height,
+             RED);
+
+    DrawLineStrip(before_points.data(),
+                  static_cast<int>(before_points.size()),
+                  BLUE);
+    DrawLineStrip(after_points.data(),
+                  static_cast<int>(after_points.size()),
+                  GREEN);
+    DrawLineStrip(count_points.data(),
+                  static_cast<int>(count_points.size()),
+                  RED);
+    DrawText(fmt::format("rule {}  {:.2f} bits per pixel  red: SOCA count  "
+                         "blue/green: bits per byte before/after",
+                         rule,
+                         window.scale)
+             .c_str(),
+             4,
+             visual_generations * cell_height + 4,
+             16,
+             DARKGRAY);
+
+    EndDrawing();
   }
+
+  UnloadTexture(texture);
+  CloseWindow();
 }
 
-// SOCA ^
+// VISUAL ^
 // HUFFMAN v
 
 template<size_t size>
@@ -169,23 +407,15 @@ struct FrequencyPair {
 // }
 
 // HUFFMAN ^
-// MEASURE v
 
-template<size_t size>
-long long measure(std::array<uint8_t, size> arr, int itr) {
-  const auto start = std::chrono::high_resolution_clock::now();
-  for (int i = 0; i < itr; ++i) {
-    soca::forward_front<113>(arr.begin(), arr.end());
-    soca::forward_back<113>(arr.begin(), arr.end());
+// --stats prints the statistics of the demo as JSON, see CACOMPRESS_STATS
+// --visual [bytes] opens the space-time viewer, 128 KiB (a megabit) default
+int main(int argc, char** argv) {
+  if (argc > 1 && std::string_view {argv[1]} == "--visual") {
+    visualize(argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 128 * 1024);
+    return 0;
   }
-  const auto end = std::chrono::high_resolution_clock::now();
-  const auto duration =
-  std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
 
-  return duration;
-}
-
-int main() {
 #if 1
   constexpr auto data_size    = 256;
   constexpr auto rule         = 220;
@@ -194,14 +424,15 @@ int main() {
   auto random_arr = create_array<data_size>();
 
   std::vector<uint8_t> compressed {};
-  compress<rule, section_size>(random_arr.begin(),
-                               random_arr.end(),
-                               std::back_inserter(compressed));
+  stream::compress(random_arr.begin(),
+                   random_arr.end(),
+                   std::back_inserter(compressed),
+                   {.rule = rule, .section_size = section_size});
 
   std::vector<uint8_t> decompressed {};
-  decompress<rule, section_size>(compressed.begin(),
-                                 compressed.end(),
-                                 std::back_inserter(decompressed));
+  stream::decompress(compressed.begin(),
+                     compressed.end(),
+                     std::back_inserter(decompressed));
 
   if (!verify_array(random_arr, decompressed)) {
     fmt::println("decompression failed");
@@ -212,46 +443,11 @@ int main() {
   fmt::println("Original size: {}", random_arr.size());
   fmt::println("Compressed size: {}", compressed.size());
   fmt::println("Decompressed size: {}", decompressed.size());
-#endif
-
-#if 0
-  constexpr static size_t itr = 50;
-
-  InitWindow(1280, 1000, "SOCA Triple: 0");
 
-  SetTargetFPS(120);
-
-  static constexpr auto input_byte_size = 256 / 8;
-
-  const auto arr = create_array<input_byte_size>();
-
-  uint8_t rule = 0;
-
-  while (!WindowShouldClose()) {
-    BeginDrawing();
-
-    ClearBackground(WHITE);
-
-    if (IsKeyPressed(KEY_LEFT)) {
-      if (rule != 0) {
-        --rule;
-        SetWindowTitle(fmt::format("SOCA Triple: {}", rule).c_str());
-      }
-    }
-
-    if (IsKeyPressed(KEY_RIGHT)) {
-      if (rule != 255) {
-        ++rule;
-        SetWindowTitle(fmt::format("SOCA Triple: {}", rule).c_str());
-      }
-    }
-
-    soca_2itr_visual(arr, rule, itr);
-
-    EndDrawing();
+  if (argc > 1 && std::string_view {argv[1]} == "--stats") {
+    fmt::print("{}", stats::to_json(stats::current()));
   }
-
-  CloseWindow();
 #endif
+
   return 0;
 }
@@ -0,0 +1,106 @@
+#include "SURVEY.hpp"
+#include <fmt/core.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// comma separated numbers, as in --rules 30,110,220
+template<typename Number>
+std::vector<Number> parse_list(std::string_view list) {
+  std::vector<Number> result;
+  while (!list.empty()) {
+    const size_t comma = list.find(',');
+    const auto   item  = std::string {list.substr(0, comma)};
+    result.push_back(
+    static_cast<Number>(std::strtoul(item.c_str(), nullptr, 10)));
+    list = comma == std::string_view::npos ? "" : list.substr(comma + 1);
+  }
+  return result;
+}
+
+bool append_file(const char* path, std::vector<uint8_t>& corpus) {
+  std::ifstream file {path, std::ios::binary};
+  if (!file) {
+    return false;
+  }
+  corpus.insert(corpus.end(),
+                std::istreambuf_iterator<char> {file},
+                std::istreambuf_iterator<char> {});
+  return true;
+}
+
+}    // namespace
+
+// usage: cacompress_survey [--rules r,r,...] [--section-sizes s,s,...]
+// [--depth n] [--threads n] [--output out.csv] corpus files...
+// the files are surveyed as one corpus, the CSV goes to stdout by default
+int main(int argc, char** argv) {
+  survey::options      opts;
+  std::string_view     output;
+  std::vector<uint8_t> corpus;
+  size_t               files = 0;
+
+  for (int arg = 1; arg < argc; ++arg) {
+    const std::string_view flag = argv[arg];
+
+    if (!flag.starts_with("--")) {
+      if (!append_file(argv[arg], corpus)) {
+        fmt::println("cannot read {}", flag);
+        return 1;
+      }
+      ++files;
+      continue;
+    }
+
+    if (arg + 1 == argc) {
+      fmt::println("missing value of {}", flag);
+      return 1;
+    }
+    const char* value = argv[++arg];
+
+    if (flag == "--rules") {
+      opts.rules = parse_list<uint8_t>(value);
+    } else if (flag == "--section-sizes") {
+      opts.section_sizes = parse_list<size_t>(value);
+    } else if (flag == "--depth") {
+      opts.depth = static_cast<uint8_t>(std::strtoul(value, nullptr, 10));
+    } else if (flag == "--threads") {
+      opts.threads = std::strtoul(value, nullptr, 10);
+    } else if (flag == "--output") {
+      output = value;
+    } else {
+      fmt::println("unknown option {}", flag);
+      return 1;
+    }
+  }
+
+  if (files == 0) {
+    fmt::println("no corpus files given");
+    return 1;
+  }
+
+  try {
+    const auto rows = survey::run(corpus.begin(), corpus.end(), opts);
+
+    if (output.empty()) {
+      survey::write_csv(std::cout, rows);
+    } else {
+      std::ofstream file {std::string {output}};
+      survey::write_csv(file, rows);
+    }
+  } catch (const std::exception& error) {
+    fmt::println("survey failed: {}", error.what());
+    return 1;
+  }
+
+  return 0;
+}